@@ -0,0 +1,40 @@
+/* libpasta -- an AST parser for Pascal
+ * Copyright (C) 2024 Dani Rodríguez <dani@danirod.es>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <stddef.h>
+
+/*
+ * A bump allocator: memory is handed out from large blocks, one piece
+ * after the other, and it is only released all at once, when the arena
+ * is freed. Allocating is a pointer increment most of the time, pieces
+ * do not need a header each, and freeing does not depend on how many
+ * pieces there are, only on the number of blocks, which grow in size.
+ */
+typedef struct arena arena_t;
+
+arena_t *arena_new(void);
+
+/* Releases every piece allocated from the arena, and the arena. */
+void arena_free(arena_t *arena);
+
+/* Zeroed memory for len bytes, aligned for any type, or NULL if out of
+ * memory. It lives until the arena is freed. */
+void *arena_alloc(arena_t *arena, size_t len);
+
+/* Bytes handed out so far. */
+size_t arena_used(arena_t *arena);
@@ -0,0 +1,87 @@
+/* libpasta -- an AST parser for Pascal
+ * Copyright (C) 2024 Dani Rodríguez <dani@danirod.es>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "parser.h"
+#include "scanner.h"
+#include "tokstream.h"
+#include <stdint.h>
+
+/*
+ * A compact form of the tree built by the parser. Nodes are stored one
+ * after the other in a single array and refer to their children and to
+ * their token by their position, with 32-bit indices instead of pointers.
+ * A node takes 16 bytes instead of the 56 of an expr_t, and since there
+ * are no pointers, the whole tree can be copied or written somewhere and
+ * used from there as it is.
+ *
+ * Tokens are stored in a token stream of the tree itself, so it does not
+ * depend on the parser. Their lexemes are still read from the scanner.
+ */
+typedef uint32_t ast_index_t;
+
+/* No node, such as a missing child. Index 0 is never a node, and token 0
+ * is always token_none. */
+#define AST_NONE 0
+
+/* The items of a LIST node are stored in the items array of the tree,
+ * from position left onwards, and right is how many there are. */
+typedef struct ast_node {
+	uint16_t type; /* expr_type_t */
+	uint16_t kind; /* node_kind_t */
+	ast_index_t token;
+	ast_index_t left, right;
+} ast_node_t;
+
+typedef struct ast {
+	ast_node_t *nodes; /* nodes[0] is unused */
+	unsigned int len;
+	unsigned int capacity;
+	tokstream_t tokens;
+	ast_index_t *items;
+	unsigned int items_len, items_cap;
+} ast_t;
+
+/* Returns 0 if out of memory. */
+int ast_init(ast_t *ast);
+void ast_free(ast_t *ast);
+
+/* Appends a node with a copy of the token. Returns its index, or AST_NONE
+ * if out of memory. */
+ast_index_t ast_add(ast_t *ast,
+                    expr_type_t type,
+                    token_t token,
+                    ast_index_t left,
+                    ast_index_t right);
+
+/* Appends a LIST node with room for count items, all of them AST_NONE
+ * until they are set. Returns AST_NONE if out of memory. */
+ast_index_t ast_add_list(ast_t *ast, token_t token, unsigned int count);
+
+/* Token of a node. */
+token_t ast_token(ast_t *ast, ast_index_t node);
+
+/*
+ * Appends a copy of a tree of expr_t nodes. Nodes are laid out in the
+ * order a depth-first walk visits them, parents first, so walking the copy
+ * goes through the array mostly forward. Returns the index of the root, or
+ * AST_NONE if expr is NULL or out of memory.
+ */
+ast_index_t ast_from_expr(ast_t *ast, const expr_t *expr);
+
+/* Prints the tree under node, in the same format as dump_expr. */
+void ast_dump(ast_t *ast, scanner_t *scanner, FILE *out, ast_index_t node);
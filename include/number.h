@@ -0,0 +1,40 @@
+/* libpasta -- an AST parser for Pascal
+ * Copyright (C) 2024 Dani Rodríguez <dani@danirod.es>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * Value of a numeric literal, converted once by the scanner so that nothing
+ * else has to parse the text again. Literals made only of digits are
+ * integers. Those with a decimal part or an exponent are reals, rounded
+ * to the nearest double.
+ */
+#define NUMBER_REAL 0x01     /* value.real is set, instead of value.integer */
+#define NUMBER_OVERFLOW 0x02 /* too large for a uint64_t or for a double */
+
+typedef struct number {
+	unsigned int flags;
+	union {
+		uint64_t integer;
+		double real;
+	} value;
+} number_t;
+
+/* Converts a literal with the syntax of TOK_DIGIT. Returns 0 if it does not
+ * have that syntax. */
+int number_parse(const char *text, unsigned int len, number_t *number);
@@ -16,43 +16,298 @@
  */
 #pragma once
 
+#include "arena.h"
 #include "scanner.h"
 #include "token.h"
+#include "tokstream.h"
+#include <setjmp.h>
 
 typedef enum expr_type {
 	UNARY, // -5
 	BINARY, // 2+3
 	GROUPING, // wrapper
 	LITERAL, // 4
+	LIST, // begin a; b; c end
 } expr_type_t;
 
+/*
+ * What a node stands for. The type of a node only tells its shape, which
+ * children it has, while the kind tells which construct it was parsed
+ * from, so that passes over the tree can switch on it instead of looking
+ * at the token. Nodes that only mark where something ends, such as a
+ * closing RPAREN, are NODE_NONE. Nodes of chains get the kind of the
+ * whole chain.
+ */
+typedef enum node_kind {
+	NODE_NONE,
+
+	/* declarations */
+	NODE_PROGRAM, // name, block
+	NODE_BLOCK, // LIST of declarations and the body
+	NODE_CONST_BLOCK, // LIST of NODE_CONST_DECL
+	NODE_CONST_DECL, // name = constant
+	NODE_TYPE_BLOCK, // LIST of NODE_TYPE_DECL
+	NODE_TYPE_DECL, // name = type
+	NODE_VAR_BLOCK, // LIST of NODE_VAR_DECL
+	NODE_VAR_DECL, // identifiers : type
+	NODE_PROCEDURE, // prototype, block
+	NODE_FUNCTION, // prototype, block
+	NODE_PROTOTYPE, // token is the name: parameters, return type
+	NODE_PARAMETERS, // chain of parameter groups
+	NODE_PARAMETER_GROUP, // token is the type: [VAR], identifiers
+	NODE_IDENTIFIER_LIST, // chain of identifiers
+
+	/* types */
+	NODE_TYPE_NAME, // a type given by its name
+	NODE_ENUM_TYPE, // chain of identifiers
+	NODE_SUBRANGE_TYPE, // low .. high
+	NODE_SIZED_TYPE, // name [ size ]
+	NODE_POINTER_TYPE, // ^ name
+	NODE_ARRAY_TYPE, // index types, element type
+	NODE_INDEX_TYPES, // chain of index types of an array
+	NODE_FILE_TYPE, // file of type
+	NODE_SET_TYPE, // set of type
+	NODE_RECORD_TYPE, // field list
+	NODE_PACKED_TYPE, // packed type
+	NODE_FIELD_LIST, // LIST of fields, variant part and its branches
+	NODE_FIELD, // identifiers : type
+	NODE_VARIANT, // case [tag :] type of
+	NODE_VARIANT_BRANCH, // labels : ( field list )
+
+	/* statements */
+	NODE_COMPOUND, // LIST of statements between BEGIN and END
+	NODE_ASSIGN, // variable := expression
+	NODE_CALL, // name, NODE_ARGUMENTS; or a bare name; see expressions
+	NODE_ARGUMENTS, // LIST of the arguments of a call
+	NODE_IF, // condition, NODE_THEN
+	NODE_THEN, // statement, NODE_ELSE
+	NODE_ELSE, // statement
+	NODE_REPEAT, // NODE_STATEMENTS, NODE_UNTIL
+	NODE_STATEMENTS, // LIST of statements
+	NODE_UNTIL, // condition
+	NODE_WHILE, // condition, statement
+	NODE_FOR, // NODE_FOR_CONTROL, statement
+	NODE_FOR_CONTROL, // token is the variable: NODE_FOR_RANGE
+	NODE_FOR_RANGE, // TO or DOWNTO: start, end
+	NODE_CASE, // expression, NODE_CASE_LIST
+	NODE_CASE_LIST, // LIST of NODE_CASE_ITEM
+	NODE_CASE_ITEM, // labels : statement
+	NODE_CASE_LABELS, // constants of a case item or variant branch
+	NODE_WITH, // variables, statement
+	NODE_WITH_VARIABLES, // chain of variables
+	NODE_GOTO, // label
+	NODE_EXIT, // identifier or PROGRAM
+
+	/* expressions */
+	NODE_IDENTIFIER,
+	NODE_NUMBER,
+	NODE_STRING,
+	NODE_NIL,
+	NODE_UNARY_OP, // sign or NOT: operand
+	NODE_BINARY_OP, // left, right
+	NODE_GROUPING, // ( expression )
+	/* NODE_CALL in an expression: token is the name: NODE_ARGUMENTS */
+	NODE_SET, // chain of elements
+	NODE_RANGE, // low .. high inside a set
+	NODE_VARIABLE, // token is the name: chain of accessors
+	NODE_FIELD_ACCESS, // . field, next accessor
+	NODE_INDEX, // [ NODE_INDEX_LIST ], next accessor
+	NODE_INDEX_LIST, // chain of indices
+	NODE_DEREF, // ^, next accessor
+} node_kind_t;
+
+/* Nodes keep a copy of their token. A grouping keeps the LPAREN of the
+ * parenthesis around its expression. Nodes without a token, such as the
+ * grouping around a type name or a list that no keyword opens, have a
+ * token of type TOK_NONE. LIST nodes have no children but an array of
+ * items, in the order they appear in the source. */
 typedef struct expr {
 	expr_type_t type;
+	node_kind_t kind;
+	unsigned int count; /* items of a LIST */
 	struct expr *exp_left, *exp_right;
-	token_t *token;
-	void *literal;
+	token_t token;
+	struct expr **items;
 } expr_t;
 
-expr_t *new_unary(token_t *t, expr_t *expr);
-expr_t *new_binary(token_t *t, expr_t *left, expr_t *right);
-expr_t *new_grouping(expr_t *exp);
-expr_t *new_literal(token_t *lit);
-void expr_free(expr_t *expr);
+typedef struct parser parser_t;
+
+/* Nodes are allocated from the arena of the parser, see parser_parse. */
+expr_t *new_unary(parser_t *parser, token_t t, expr_t *expr);
+expr_t *new_binary(parser_t *parser, token_t t, expr_t *left, expr_t *right);
+expr_t *new_grouping(parser_t *parser, expr_t *exp);
+expr_t *new_literal(parser_t *parser, token_t lit);
+
+/* Sets the kind of a node and returns it, for use along the constructors. */
+expr_t *expr_kind(expr_t *expr, node_kind_t kind);
+
+/* Name of a kind, such as "IF" for NODE_IF. */
+const char *node_kind_string(node_kind_t kind);
+
+/*
+ * Lists are collected on a stack shared by every list being parsed, since
+ * a list may be nested in an item of another one. Take the height of the
+ * stack before the first item, push every item, and then new_list moves
+ * the items pushed since that height into the node.
+ */
+unsigned int parser_list_start(parser_t *parser);
+void parser_list_push(parser_t *parser, expr_t *item);
+expr_t *new_list(parser_t *parser, token_t t, unsigned int start);
 
-typedef struct parser {
-	token_t **tokens;
-	unsigned int len;
+/*
+ * How far ahead of the current token the grammar looks. parser_peek_far
+ * never needs an offset of PARSER_LOOKAHEAD or more. Power of two.
+ */
+#define PARSER_LOOKAHEAD 4
+
+/*
+ * How deep statements can be nested by default, such as an IF inside a
+ * BEGIN inside a WHILE, and how deep expressions can be, such as a group
+ * inside the arguments of a call. Statements, groups and calls are parsed
+ * with stacks of their own instead of the C stack, so this is mostly not
+ * about crashing but about giving an error for input that no one wrote by
+ * hand. Sets and indexes still recurse, and the limit keeps them within
+ * the C stack.
+ */
+#define PARSER_MAX_DEPTH 10000
+
+struct stmt_frame;
+struct pending;
+
+/* A syntax error found while parsing, at the given token. */
+typedef struct diagnostic {
+	token_t token;
+	unsigned int line, col;
+	const char *message;
+} diagnostic_t;
+
+/*
+ * A parser either reads from the tokens loaded with parser_load_tokens, or
+ * pulls them from the scanner as the grammar asks for them. In the second
+ * case only the tokens between pos and pos + PARSER_LOOKAHEAD are kept, in
+ * a ring buffer indexed by the absolute token position, so the memory used
+ * for tokens does not depend on the length of the input.
+ */
+struct parser {
+	tokstream_t tokens;
 	unsigned int pos;
-} parser_t;
+	scanner_t *scanner;
+
+	int streaming;
+	token_t ring[PARSER_LOOKAHEAD];
+	unsigned int ring_len; /* tokens buffered from pos onwards. */
+	int ring_eof;          /* the last one buffered is TOK_EOF. */
+
+	/* token file mapped by parser_load_tokfile, which owns the scanner
+	 * and whose arrays the tokens point into. */
+	void *mapped;
+	size_t mapped_len;
+
+	/* nodes parsed since the last parser_parse, created on demand. */
+	arena_t *arena;
 
+	/* items of the lists being parsed, see parser_list_start. */
+	expr_t **list_items;
+	unsigned int list_len, list_cap;
+
+	/* statements waiting for the statement nested in them. */
+	struct stmt_frame *stmt_frames;
+	unsigned int stmt_len, stmt_cap;
+	unsigned int max_depth;
+
+	/* operators and brackets of the expressions being parsed, and how
+	 * deep they are nested, see parse_operators. */
+	struct pending *pending;
+	unsigned int pending_len, pending_cap;
+	unsigned int expr_depth;
+
+	/* errors found since the last parser_parse, and where parser_error
+	 * goes on after recording one, see parser_skip_to. */
+	diagnostic_t *diagnostics;
+	unsigned int diagnostics_len, diagnostics_cap;
+	jmp_buf *recover;
+	unsigned int recover_pos;
+};
+
+/*
+ * A parsed tree along with the arena that holds every node of it. The
+ * nodes keep their tokens, whose lexemes are still read from the scanner,
+ * so the scanner must outlive the result, but the parser does not need to.
+ *
+ * If the input has errors, they are in diagnostics, in the order they
+ * were found, and the tree has the parts of the input around them. Parts
+ * with errors are missing from it, and root may even be NULL.
+ */
+typedef struct parse_result {
+	expr_t *root;
+	arena_t *arena;
+	diagnostic_t *diagnostics;
+	unsigned int diagnostics_len;
+} parse_result_t;
+
+/* Parsers share no state, so every thread can have its own, along with its
+ * own scanner. A parser and its scanner must not be used by two threads at
+ * the same time, though. */
 parser_t *parser_new();
-void parser_load_tokens(parser_t *parser, scanner_t *scanner);
-token_t *parser_peek(parser_t *parser);
-token_t *parser_peek_far(parser_t *parser, unsigned int offt);
-token_t *parser_token(parser_t *parser);
-token_t *parser_token_expect(parser_t *, tokentype_t);
+
+/* Scans every token in the scanner into the parser. The scanner must outlive
+ * the parser, and have the whole input, since the lexemes of chunked input
+ * would be gone by the time the tokens are used. Returns 0 if it runs out
+ * of memory or the scanner reads its input in chunks. */
+int parser_load_tokens(parser_t *parser, scanner_t *scanner);
+
+/* The same, but scanning the input with up to the given number of threads,
+ * see scanner_tokenize. */
+int parser_load_tokens_parallel(parser_t *parser,
+                                scanner_t *scanner,
+                                unsigned int threads);
+
+/*
+ * Makes the parser pull tokens from the scanner only as it needs them,
+ * instead of loading them all beforehand. The scanner may read its input
+ * in chunks then, but only the tokens that are still in its window have a
+ * lexeme, see scanner_lexeme, so the tree of such input has every token
+ * type but only the lexemes of the last few tokens.
+ */
+void parser_stream_tokens(parser_t *parser, scanner_t *scanner);
+
+/* Makes statements or expressions nested deeper than depth an error. 0 means
+ * no limit. */
+void parser_set_max_depth(parser_t *parser, unsigned int depth);
+
+/* Frees the parser, and every node parsed with it that was not handed
+ * over to a parse_result_t. */
+void parser_free(parser_t *parser);
+
+/* Parses with the given rule, such as parser_program, and hands over the
+ * nodes to the result. Returns NULL if out of memory, which includes the
+ * scanner running out of it while streaming tokens. */
+parse_result_t *parser_parse(parser_t *parser, expr_t *(*rule)(parser_t *));
+
+/* Frees a whole tree at once, without visiting its nodes. */
+void parse_result_free(parse_result_t *result);
+
+token_t parser_peek(parser_t *parser);
+token_t parser_peek_far(parser_t *parser, unsigned int offt);
+token_t parser_token(parser_t *parser);
+token_t parser_token_expect(parser_t *, tokentype_t);
+
+/*
+ * Records an error at the given token and unwinds to the innermost rule
+ * that can recover from it, such as the statement or the declaration that
+ * has the error. Rules must be run by parser_parse, since outside of it
+ * there is nothing to unwind to.
+ */
 void __attribute__((noreturn))
-parser_error(parser_t *parser, token_t *token, char *error);
+parser_error(parser_t *parser, token_t token, char *error);
+
+/*
+ * Panic mode. After an error, skips tokens until one that stop accepts,
+ * or TOK_EOF, without taking it. If the previous error was recovered at
+ * the same token, that token is skipped first, so that recovering always
+ * makes progress.
+ */
+void parser_skip_to(parser_t *parser, int (*stop)(tokentype_t));
 
 expr_t *parser_identifier_list(parser_t *parser);
 
@@ -74,4 +329,7 @@ expr_t *parser_statement(parser_t *parser);
 expr_t *parser_block(parser_t *parser);
 expr_t *parser_program(parser_t *parser);
 
-void dump_expr(expr_t *expr);
+void dump_expr(parser_t *parser, FILE *out, expr_t *expr);
+
+/* The same, but printing the kind of every node instead of its type. */
+void dump_expr_kinds(parser_t *parser, FILE *out, expr_t *expr);
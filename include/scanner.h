@@ -16,12 +16,128 @@
  */
 #pragma once
 
+#include "number.h"
+#include "strarena.h"
+#include "symtab.h"
 #include "token.h"
+#include "tokstream.h"
 #include <stdio.h>
+
+/* Like the tables given to it, a scanner can only be used by one thread at
+ * a time, since even scanner_position updates it. */
 typedef struct scanner scanner_t;
 
+/*
+ * Number of NUL bytes that must follow the input of a padded scanner. The
+ * scanner relies on them as a sentinel instead of checking the length of
+ * the input on every read, and a NUL byte anywhere is the end of input.
+ */
+#define SCANNER_PADDING 64
+
+/* Scans a copy of the given buffer, so it does not need any padding. */
 scanner_t *scanner_init(char *, size_t);
 
-token_t *scanner_next(scanner_t *);
+/* Scans the given buffer in place. The len bytes of input must be followed
+ * by SCANNER_PADDING bytes set to zero, and it must outlive the scanner. */
+scanner_t *scanner_init_padded(char *, size_t);
+
+/* Scans a file by mapping it into memory, with no copy. Returns NULL if
+ * the descriptor is not a regular file or cannot be mapped, so the caller
+ * can fall back to reading it. The descriptor may be closed afterwards. */
+scanner_t *scanner_init_mapped(int fd);
+
+/*
+ * Chunked input. Instead of a buffer with the whole input, the scanner
+ * keeps a window of it and calls the reader whenever a token gets close to
+ * the end of the window. The reader stores up to len bytes into buf and
+ * returns how many, or 0 at the end of the input or on error.
+ *
+ * Memory is bounded by the chunk size plus the longest token or comment.
+ * Token offsets still count from the start of the whole input, modulo
+ * 2^32, but the lexeme of a token can only be read until the next call
+ * to scanner_next, and positions only for the tokens still in the window.
+ */
+typedef size_t (*scanner_read_t)(void *ctx, char *buf, size_t len);
+
+/* Default amount of bytes asked to the reader, when chunk is 0. */
+#define SCANNER_CHUNK 65536
+
+scanner_t *scanner_init_reader(scanner_read_t read, void *ctx, size_t chunk);
+
+/* Chunked input read from a file descriptor, which is not closed. */
+scanner_t *scanner_init_fd(int fd, size_t chunk);
+
+/* Reads a file descriptor until its end into a new buffer, followed by
+ * SCANNER_PADDING zero bytes, so it can be given to scanner_init_padded,
+ * and stores its length into len. Returns NULL, with errno set, if it
+ * cannot be read or out of memory. The caller frees the buffer. */
+char *scanner_read_all(int fd, size_t *len);
+
+/* Scans the whole input of a file descriptor that cannot be mapped, such
+ * as a pipe, read with scanner_read_all into a buffer that the scanner
+ * owns. The descriptor may be closed afterwards. */
+scanner_t *scanner_init_read(int fd);
+
+/* Interns every identifier scanned from now on into the given table and
+ * stores its symbol ID as the token value. NULL stops interning. The table
+ * is not owned by the scanner. */
+void scanner_set_symtab(scanner_t *, symtab_t *);
+
+/* The same for string literals: they are decoded into the given arena, and
+ * the token value is their string ID. */
+void scanner_set_strarena(scanner_t *, strarena_t *);
+
+token_t scanner_next(scanner_t *);
+
+/* Value of a TOK_DIGIT token, converted while scanning it, or NULL if
+ * it could not be stored. Like lexemes, it lives as long as the scanner,
+ * or for chunked input, until the next call to scanner_next. */
+const number_t *scanner_number(scanner_t *, const token_t *);
+
+/* Every number converted so far, in the order of their token values. */
+const number_t *scanner_numbers(scanner_t *, unsigned int *count);
+
+/* Makes the scanner look up numbers in a table that was converted before,
+ * such as one stored in a token file, instead of its own. It is not owned
+ * by the scanner and no more numbers can be added to it. */
+void scanner_use_numbers(scanner_t *, const number_t *, unsigned int count);
+
+/* Whether the scanner ran out of memory reading chunked input. Its last
+ * TOK_EOF is then where it stopped and not the end of the input. */
+int scanner_failed(scanner_t *);
+
+/* The whole input, padded, or NULL for chunked input. */
+const char *scanner_source(scanner_t *);
+
+/*
+ * Scans every token left, up to and including TOK_EOF, into the stream.
+ * The tokens are the same that calling scanner_next in a loop would give,
+ * but the input is split among up to the given number of threads: a quick
+ * pass over it finds whitespace that is outside strings and comments, and
+ * every thread scans from one of those points to the next one. Chunked
+ * input and short inputs are always scanned on the calling thread.
+ * Returns 0 if out of memory.
+ */
+int scanner_tokenize(scanner_t *, tokstream_t *, unsigned int threads);
+
+/* Length in bytes of the input, not counting the padding. For chunked
+ * input, the length of the part of it currently in memory. */
+size_t scanner_length(scanner_t *);
+
+/* Pointer to the first character of the token lexeme inside the scanner
+ * buffer. It is not NUL-terminated: read exactly token->length chars.
+ * NULL for chunked input once the token has left the window. */
+const char *scanner_lexeme(scanner_t *, const token_t *);
+
+/* NUL-terminated copy of the token lexeme. Must be freed by the caller.
+ * NULL if out of memory or if the lexeme is gone. */
+char *scanner_lexeme_dup(scanner_t *, const token_t *);
+
+/* Line and column, both starting at 1, of the byte at the given offset.
+ * The first call indexes the lines of the input. Returns 0 on failure. */
+int scanner_position(scanner_t *,
+                     unsigned int offset,
+                     unsigned int *line,
+                     unsigned int *col);
 
 void scanner_free(scanner_t *);
@@ -0,0 +1,55 @@
+/* libpasta -- an AST parser for Pascal
+ * Copyright (C) 2024 Dani Rodríguez <dani@danirod.es>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * Storage for the decoded contents of string literals: the quotes are
+ * removed, doubled quotes become a single one and control codes such as
+ * #13 become the character they stand for. Every distinct string is
+ * stored once and gets an ID, starting at 1, so repeated literals share
+ * their storage. See scanner_set_strarena.
+ *
+ * Strings may have NUL characters in them, so they always come with their
+ * length, but they are also NUL-terminated for convenience.
+ */
+typedef struct strarena strarena_t;
+
+/* Not a string: tokens that are not strings, or out of memory. */
+#define STRARENA_NONE 0
+
+strarena_t *strarena_new(void);
+void strarena_free(strarena_t *arena);
+
+/* ID of a string with the given contents, which is added if it is new. */
+uint32_t strarena_add(strarena_t *arena, const char *data, unsigned int len);
+
+/*
+ * Adding a string without building it somewhere else first: reserve room
+ * for up to len characters, write them to the returned pointer, and then
+ * commit the length that was actually written. Returns NULL or
+ * STRARENA_NONE if out of memory.
+ */
+char *strarena_reserve(strarena_t *arena, unsigned int len);
+uint32_t strarena_commit(strarena_t *arena, unsigned int len);
+
+/* Contents of a string, and its length if len is not NULL. */
+const char *strarena_get(strarena_t *arena, uint32_t id, unsigned int *len);
+
+/* Number of distinct strings. */
+unsigned int strarena_count(strarena_t *arena);
@@ -0,0 +1,46 @@
+/* libpasta -- an AST parser for Pascal
+ * Copyright (C) 2024 Dani Rodríguez <dani@danirod.es>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * Identifier interning. Pascal identifiers are case-insensitive, so every
+ * identifier is folded to lowercase and given a dense symbol ID, starting
+ * at 1, the first time it is seen. The same name in any case always gets
+ * the same ID, so later passes can compare names as integers, and every
+ * distinct name is stored only once.
+ *
+ * A symbol table is meant to live as long as a compilation, and can be
+ * shared by every scanner involved in it, see scanner_set_symtab.
+ */
+typedef struct symtab symtab_t;
+
+/* Not a symbol: tokens that are not identifiers, or out of memory. */
+#define SYMTAB_NONE 0
+
+symtab_t *symtab_new(void);
+void symtab_free(symtab_t *symtab);
+
+/* ID of the given name, which is added if it is new. */
+uint32_t symtab_intern(symtab_t *symtab, const char *name, unsigned int len);
+
+/* Lowercase, NUL-terminated name of a symbol. */
+const char *symtab_name(symtab_t *symtab, uint32_t id);
+
+/* Number of distinct symbols. */
+unsigned int symtab_count(symtab_t *symtab);
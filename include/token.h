@@ -17,6 +17,7 @@
 #pragma once
 
 typedef enum tokentype {
+	TOK_NONE, /* not a real token, see token_none */
 	TOK_EOF,
 
 	TOK_AND,
@@ -83,14 +84,29 @@ typedef enum tokentype {
 	TOK_WITH,
 } tokentype_t;
 
+/*
+ * A token does not own a copy of its lexeme. Instead, offset and length
+ * describe a slice of the buffer given to the scanner that produced it.
+ * Tokens that have no interesting lexeme (keywords and symbols) have a
+ * length of zero, while identifiers, numbers and strings have the length
+ * of the text that was read. Use scanner_lexeme() to access the text, and
+ * scanner_position() to turn the offset into a line and a column.
+ *
+ * The meaning of value depends on the type of token. For identifiers, it
+ * is their symbol ID when the scanner interns them, see symtab.h. For
+ * strings, it is their string ID when the scanner decodes them, see
+ * strarena.h. For numbers it identifies their converted value, see
+ * scanner_number(). It is 0 when there is nothing to tell.
+ */
 typedef struct token {
 	tokentype_t type;
-	char *meta;
-	unsigned int line, col;
+	unsigned int offset, length;
+	unsigned int value;
 } token_t;
 
-void token_free(token_t *tok);
+/* Placeholder for expressions that do not have a token. */
+extern const token_t token_none;
 
 const char *tokentype_string(tokentype_t token);
 
-tokentype_t match_identifier(char *input);
+tokentype_t match_identifier(const char *input, unsigned int len);
@@ -0,0 +1,51 @@
+/* libpasta -- an AST parser for Pascal
+ * Copyright (C) 2024 Dani Rodríguez <dani@danirod.es>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "parser.h"
+#include "scanner.h"
+#include "tokstream.h"
+#include <stdio.h>
+
+/*
+ * Token files keep the result of scanning a source file, so that it can be
+ * parsed again later without scanning it again. A token file has a header,
+ * the source itself, so that lexemes and positions still work, the token
+ * stream as parallel arrays of types, offsets, lengths and values, and the
+ * converted numbers. Every section is aligned so that a mapped file can be
+ * used in place.
+ *
+ * The arrays are stored in the byte order of the machine that wrote them,
+ * and files are only read on machines with the same one and with the same
+ * TOKFILE_VERSION. Symbol and string IDs in token values are kept as they
+ * are, but their tables are not stored.
+ */
+#define TOKFILE_VERSION 1
+
+/* Writes the given tokens, scanned from the given scanner, which must not
+ * have chunked input. Returns 0 on failure. */
+int tokfile_write(FILE *fp, scanner_t *scanner, tokstream_t *stream);
+
+/* Loads the tokens of a token file into a parser by mapping it in memory.
+ * The parser owns the mapping and a scanner over the source stored in it,
+ * available as parser->scanner, until parser_free. Returns 0 if the file
+ * cannot be mapped or is not a valid token file, which includes tokens or
+ * numbers that point outside of it. */
+int parser_load_tokfile(parser_t *parser, int fd);
+
+/* Releases what parser_load_tokfile mapped. Called by parser_free. */
+void tokfile_unmap(parser_t *parser);
@@ -0,0 +1,51 @@
+/* libpasta -- an AST parser for Pascal
+ * Copyright (C) 2024 Dani Rodríguez <dani@danirod.es>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "token.h"
+#include <stdint.h>
+
+/*
+ * A growable list of tokens, stored as parallel arrays instead of as an
+ * array of token structures, so that lookahead, which mostly checks the
+ * type of the next tokens, only touches the densely packed types.
+ *
+ * The arrays grow by doubling their capacity, so pushing n tokens is
+ * linear no matter how many there are.
+ */
+typedef struct tokstream {
+	uint8_t *types;
+	uint32_t *offsets;
+	uint32_t *lengths;
+	uint32_t *values;
+	unsigned int len;
+	unsigned int capacity;
+} tokstream_t;
+
+void tokstream_init(tokstream_t *stream);
+void tokstream_free(tokstream_t *stream);
+
+/* Makes room for at least capacity tokens. Returns 0 if out of memory. */
+int tokstream_reserve(tokstream_t *stream, unsigned int capacity);
+
+/* Appends a token at the end. Returns 0 if out of memory. */
+int tokstream_push(tokstream_t *stream, token_t token);
+
+/* Appends every token of other at the end. Returns 0 if out of memory. */
+int tokstream_append(tokstream_t *stream, tokstream_t *other);
+
+token_t tokstream_get(tokstream_t *stream, unsigned int pos);
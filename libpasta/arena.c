@@ -0,0 +1,143 @@
+/* libpasta -- an AST parser for Pascal
+ * Copyright (C) 2024 Dani Rodríguez <dani@danirod.es>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "arena.h"
+#include <stdlib.h>
+
+/*
+ * Blocks are kept in a list, the current one first. Every block is twice
+ * as large as the one before it, up to ARENA_MAX_BLOCK. A piece larger
+ * than the next block would be gets a block of its own instead, which is
+ * linked behind the current one, so that the room left in it is still
+ * used by the pieces that come after.
+ */
+#define ARENA_ALIGN 16
+
+struct block {
+	struct block *next;
+	size_t size;
+	char data[] __attribute__((aligned(ARENA_ALIGN)));
+};
+
+struct arena {
+	struct block *blocks;
+	char *next; /* first free byte in the current block */
+	char *end;  /* end of the current block */
+	size_t block_size, used;
+};
+
+#define ARENA_FIRST_BLOCK 16384
+#define ARENA_MAX_BLOCK (4 * 1024 * 1024)
+
+arena_t *
+arena_new(void)
+{
+	arena_t *arena = calloc(1, sizeof(arena_t));
+
+	if (arena) {
+		arena->block_size = ARENA_FIRST_BLOCK;
+	}
+	return arena;
+}
+
+void
+arena_free(arena_t *arena)
+{
+	struct block *block, *next;
+
+	for (block = arena->blocks; block; block = next) {
+		next = block->next;
+		free(block);
+	}
+	free(arena);
+}
+
+/* calloc gets fresh zeroed pages for large blocks, without a memset */
+static struct block *
+new_block(size_t size)
+{
+	struct block *block;
+
+	if ((block = calloc(1, sizeof(struct block) + size)) != NULL) {
+		block->size = size;
+	}
+	return block;
+}
+
+static int
+arena_grow(arena_t *arena)
+{
+	struct block *block;
+
+	if ((block = new_block(arena->block_size)) == NULL) {
+		return 0;
+	}
+	block->next = arena->blocks;
+	arena->blocks = block;
+	arena->next = block->data;
+	arena->end = block->data + block->size;
+	if (arena->block_size < ARENA_MAX_BLOCK) {
+		arena->block_size *= 2;
+	}
+	return 1;
+}
+
+/* A block for a single piece, behind the current block. */
+static void *
+arena_alloc_large(arena_t *arena, size_t len)
+{
+	struct block *block;
+
+	if ((block = new_block(len)) == NULL) {
+		return NULL;
+	}
+	if (arena->blocks) {
+		block->next = arena->blocks->next;
+		arena->blocks->next = block;
+	} else {
+		block->next = NULL;
+		arena->blocks = block;
+	}
+	arena->used += len;
+	return block->data;
+}
+
+void *
+arena_alloc(arena_t *arena, size_t len)
+{
+	void *ptr;
+
+	len = len ? (len + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1)
+	          : ARENA_ALIGN;
+	if ((size_t) (arena->end - arena->next) < len) {
+		if (len > arena->block_size) {
+			return arena_alloc_large(arena, len);
+		}
+		if (!arena_grow(arena)) {
+			return NULL;
+		}
+	}
+	ptr = arena->next;
+	arena->next += len;
+	arena->used += len;
+	return ptr;
+}
+
+size_t
+arena_used(arena_t *arena)
+{
+	return arena->used;
+}
@@ -0,0 +1,325 @@
+/* libpasta -- an AST parser for Pascal
+ * Copyright (C) 2024 Dani Rodríguez <dani@danirod.es>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "ast.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+int
+ast_init(ast_t *ast)
+{
+	ast->nodes = NULL;
+	ast->len = 1;
+	ast->capacity = 0;
+	ast->items = NULL;
+	ast->items_len = 0;
+	ast->items_cap = 0;
+	tokstream_init(&ast->tokens);
+	return tokstream_push(&ast->tokens, token_none);
+}
+
+void
+ast_free(ast_t *ast)
+{
+	free(ast->nodes);
+	free(ast->items);
+	tokstream_free(&ast->tokens);
+	ast->nodes = NULL;
+	ast->len = 1;
+	ast->capacity = 0;
+	ast->items = NULL;
+	ast->items_len = 0;
+	ast->items_cap = 0;
+}
+
+ast_index_t
+ast_add(ast_t *ast,
+        expr_type_t type,
+        token_t token,
+        ast_index_t left,
+        ast_index_t right)
+{
+	ast_node_t *nodes, *node;
+	unsigned int capacity;
+
+	if (ast->len >= ast->capacity) {
+		capacity = ast->capacity ? ast->capacity * 2 : 64;
+		nodes = realloc(ast->nodes, sizeof(ast_node_t) * capacity);
+		if (nodes == NULL) {
+			return AST_NONE;
+		}
+		ast->nodes = nodes;
+		ast->capacity = capacity;
+	}
+	node = &ast->nodes[ast->len];
+	node->type = type;
+	node->kind = NODE_NONE;
+	node->token = AST_NONE;
+	node->left = left;
+	node->right = right;
+	if (token.type != TOK_NONE) {
+		node->token = ast->tokens.len;
+		if (!tokstream_push(&ast->tokens, token)) {
+			return AST_NONE;
+		}
+	}
+	return ast->len++;
+}
+
+ast_index_t
+ast_add_list(ast_t *ast, token_t token, unsigned int count)
+{
+	ast_index_t *items;
+	unsigned int cap = ast->items_cap, i;
+
+	while (cap - ast->items_len < count) {
+		cap = cap ? cap * 2 : 64;
+	}
+	if (cap != ast->items_cap) {
+		if ((items = realloc(ast->items, sizeof(ast_index_t) * cap))
+		    == NULL) {
+			return AST_NONE;
+		}
+		ast->items = items;
+		ast->items_cap = cap;
+	}
+	for (i = 0; i < count; i++) {
+		ast->items[ast->items_len + i] = AST_NONE;
+	}
+	ast->items_len += count;
+	return ast_add(ast, LIST, token, ast->items_len - count, count);
+}
+
+token_t
+ast_token(ast_t *ast, ast_index_t node)
+{
+	return tokstream_get(&ast->tokens, ast->nodes[node].token);
+}
+
+/*
+ * Both walks below keep their own stack instead of recursing, because
+ * lists are chains of nodes as deep as the list is long.
+ */
+struct pending {
+	const expr_t *expr; /* to be copied, */
+	ast_index_t parent; /* and where to link the copy: */
+	uint32_t link;      /* LINK_LEFT, LINK_RIGHT or a position in items, */
+	ast_index_t node;   /* or to be printed, */
+	unsigned int depth; /* and how far down in the tree. */
+};
+
+#define LINK_LEFT UINT32_MAX
+#define LINK_RIGHT (UINT32_MAX - 1)
+
+static int
+push(struct pending **stack,
+     unsigned int *len,
+     unsigned int *cap,
+     struct pending item)
+{
+	struct pending *grown;
+
+	if (*len == *cap) {
+		*cap = *cap ? *cap * 2 : 64;
+		if ((grown = realloc(*stack, sizeof(**stack) * *cap)) == NULL) {
+			return 0;
+		}
+		*stack = grown;
+	}
+	(*stack)[(*len)++] = item;
+	return 1;
+}
+
+/* Pushes the children of item.expr, to be linked to item.parent. */
+static int
+push_children(struct pending **stack,
+              unsigned int *len,
+              unsigned int *cap,
+              ast_t *ast,
+              struct pending item)
+{
+	const expr_t *expr = item.expr;
+	unsigned int i;
+
+	for (i = expr->count; i > 0; i--) {
+		item.expr = expr->items[i - 1];
+		item.link = ast->nodes[item.parent].left + i - 1;
+		if (item.expr && !push(stack, len, cap, item)) {
+			return 0;
+		}
+	}
+	if (expr->exp_right) {
+		item.expr = expr->exp_right;
+		item.link = LINK_RIGHT;
+		if (!push(stack, len, cap, item)) {
+			return 0;
+		}
+	}
+	if (expr->exp_left) {
+		item.expr = expr->exp_left;
+		item.link = LINK_LEFT;
+		if (!push(stack, len, cap, item)) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+ast_index_t
+ast_from_expr(ast_t *ast, const expr_t *expr)
+{
+	struct pending *stack = NULL, item;
+	unsigned int len = 0, cap = 0;
+	ast_index_t root = AST_NONE, index;
+
+	if (expr == NULL) {
+		return AST_NONE;
+	}
+	item.expr = expr;
+	item.parent = AST_NONE;
+	item.link = LINK_LEFT;
+	item.node = AST_NONE;
+	item.depth = 0;
+	if (!push(&stack, &len, &cap, item)) {
+		return AST_NONE;
+	}
+	while (len > 0) {
+		item = stack[--len];
+		expr = item.expr;
+		if (expr->type == LIST) {
+			index = ast_add_list(ast, expr->token, expr->count);
+		} else {
+			index = ast_add(ast,
+			                expr->type,
+			                expr->token,
+			                AST_NONE,
+			                AST_NONE);
+		}
+		if (index == AST_NONE) {
+			root = AST_NONE;
+			break;
+		}
+		ast->nodes[index].kind = expr->kind;
+		if (item.parent == AST_NONE) {
+			root = index;
+		} else if (item.link == LINK_RIGHT) {
+			ast->nodes[item.parent].right = index;
+		} else if (item.link == LINK_LEFT) {
+			ast->nodes[item.parent].left = index;
+		} else {
+			ast->items[item.link] = index;
+		}
+
+		/* the first child is pushed last so that it comes next. */
+		item.parent = index;
+		if (!push_children(&stack, &len, &cap, ast, item)) {
+			root = AST_NONE;
+			break;
+		}
+	}
+	free(stack);
+	return root;
+}
+
+static void
+print_token(ast_t *ast, scanner_t *scanner, FILE *out, ast_index_t node)
+{
+	token_t tok = ast_token(ast, node);
+	const char *lexeme = scanner_lexeme(scanner, &tok);
+
+	if (tok.type == TOK_NONE) {
+		return;
+	}
+	if (tok.length != 0 && lexeme != NULL) {
+		fprintf(out,
+		        "%s(%.*s)\n",
+		        tokentype_string(tok.type),
+		        (int) tok.length,
+		        lexeme);
+	} else {
+		fprintf(out, "%s\n", tokentype_string(tok.type));
+	}
+}
+
+static const char *
+node_type_string(uint32_t type)
+{
+	switch (type) {
+	case BINARY:
+		return "BINARY ";
+	case UNARY:
+		return "UNARY ";
+	case GROUPING:
+		return "GROUPING ";
+	case LITERAL:
+		return "LITERAL ";
+	case LIST:
+		return "LIST ";
+	}
+	return "";
+}
+
+void
+ast_dump(ast_t *ast, scanner_t *scanner, FILE *out, ast_index_t node)
+{
+	struct pending *stack = NULL, item = {NULL, AST_NONE, 0, node, 0};
+	unsigned int len = 0, cap = 0, i;
+	ast_index_t children[2];
+	ast_node_t *n;
+	token_t token;
+	int ok;
+
+	if (node == AST_NONE || !push(&stack, &len, &cap, item)) {
+		return;
+	}
+	while (len > 0) {
+		item = stack[--len];
+		n = &ast->nodes[item.node];
+		for (i = 0; i < item.depth; i++) {
+			fputs(i == item.depth - 1 ? "|- " : "|  ", out);
+		}
+		token = ast_token(ast, item.node);
+		if (n->type == LIST && token.type == TOK_NONE) {
+			fputs("LIST\n", out);
+		} else {
+			fputs(node_type_string(n->type), out);
+			print_token(ast, scanner, out, item.node);
+		}
+
+		/* the first child is pushed last, to be printed first. */
+		item.depth++;
+		ok = 1;
+		if (n->type == LIST) {
+			for (i = n->right; ok && i > 0; i--) {
+				item.node = ast->items[n->left + i - 1];
+				ok = item.node == AST_NONE
+				     || push(&stack, &len, &cap, item);
+			}
+		} else {
+			children[0] = n->right;
+			children[1] = n->left;
+			for (i = 0; ok && i < 2; i++) {
+				item.node = children[i];
+				ok = item.node == AST_NONE
+				     || push(&stack, &len, &cap, item);
+			}
+		}
+		if (!ok) {
+			break;
+		}
+	}
+	free(stack);
+}
@@ -0,0 +1,152 @@
+/* libpasta -- an AST parser for Pascal
+ * Copyright (C) 2024 Dani Rodríguez <dani@danirod.es>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "intern.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* FNV-1a */
+static uint32_t
+hash_data(const char *data, unsigned int len)
+{
+	uint32_t hash = 2166136261u;
+	unsigned int i;
+
+	for (i = 0; i < len; i++) {
+		hash ^= (unsigned char) data[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+int
+intern_init(struct intern *table, uint32_t slots)
+{
+	memset(table, 0, sizeof(*table));
+	if ((table->slots = calloc(slots, sizeof(uint32_t))) == NULL) {
+		return 0;
+	}
+	table->mask = slots - 1;
+	return 1;
+}
+
+void
+intern_destroy(struct intern *table)
+{
+	free(table->data);
+	free(table->entries);
+	free(table->slots);
+}
+
+static int
+intern_rehash(struct intern *table)
+{
+	uint32_t mask = table->mask * 2 + 1, id, slot;
+	uint32_t *slots = calloc(mask + 1, sizeof(uint32_t));
+
+	if (slots == NULL) {
+		return 0;
+	}
+	for (id = 1; id <= table->count; id++) {
+		slot = table->entries[id].hash & mask;
+		while (slots[slot] != 0) {
+			slot = (slot + 1) & mask;
+		}
+		slots[slot] = id;
+	}
+	free(table->slots);
+	table->slots = slots;
+	table->mask = mask;
+	return 1;
+}
+
+char *
+intern_reserve(struct intern *table, unsigned int len)
+{
+	size_t cap;
+	char *next;
+
+	if (table->data_len + len + 1 > table->data_cap) {
+		cap = table->data_cap ? table->data_cap * 2 : 4096;
+		while (cap < table->data_len + len + 1) {
+			cap *= 2;
+		}
+		if ((next = realloc(table->data, cap)) == NULL) {
+			return NULL;
+		}
+		table->data = next;
+		table->data_cap = cap;
+	}
+	return table->data + table->data_len;
+}
+
+uint32_t
+intern_commit(struct intern *table, unsigned int len)
+{
+	const char *data = table->data + table->data_len;
+	uint32_t hash = hash_data(data, len), slot, id;
+	struct intern_entry *entry;
+	void *next;
+	size_t cap;
+
+	for (slot = hash & table->mask; (id = table->slots[slot]) != 0;
+	     slot = (slot + 1) & table->mask) {
+		entry = &table->entries[id];
+		if (entry->hash == hash && entry->length == len
+		    && !memcmp(table->data + entry->offset, data, len)) {
+			return id;
+		}
+	}
+
+	if (table->count >= table->mask) {
+		return INTERN_NONE; // keep an empty slot to end the probes
+	}
+	if (table->count + 1 >= table->entries_cap) {
+		cap = table->entries_cap ? table->entries_cap * 2 : 64;
+		next = realloc(table->entries, sizeof(*table->entries) * cap);
+		if (next == NULL) {
+			return INTERN_NONE;
+		}
+		table->entries = next;
+		table->entries_cap = cap;
+	}
+
+	entry = &table->entries[++table->count];
+	entry->offset = table->data_len;
+	entry->length = len;
+	entry->hash = hash;
+	table->data[table->data_len + len] = 0;
+	table->data_len += len + 1;
+
+	table->slots[slot] = table->count;
+	if (table->count * 2 > table->mask) {
+		// a failed rehash just leaves the table fuller than it should
+		intern_rehash(table);
+	}
+	return table->count;
+}
+
+const char *
+intern_get(struct intern *table, uint32_t id, unsigned int *len)
+{
+	if (id == INTERN_NONE || id > table->count) {
+		return NULL;
+	}
+	if (len) {
+		*len = table->entries[id].length;
+	}
+	return table->data + table->entries[id].offset;
+}
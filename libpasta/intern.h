@@ -0,0 +1,67 @@
+/* libpasta -- an AST parser for Pascal
+ * Copyright (C) 2024 Dani Rodríguez <dani@danirod.es>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Interning of byte strings, shared by the symbol table and the string
+ * arena. Every distinct string gets a dense ID, starting at 1, the first
+ * time it is committed, and is stored only once.
+ *
+ * Strings are stored NUL-terminated one after the other in a single
+ * growing buffer. A new string is written at its end, and the end only
+ * moves forward if the string is not already there, which the hash table
+ * finds out. The table uses open addressing with linear probing, and its
+ * slots hold the ID, so that 0 marks an empty slot. It is kept at most
+ * half full.
+ */
+struct intern_entry {
+	uint32_t offset;
+	uint32_t length;
+	uint32_t hash;
+};
+
+struct intern {
+	char *data;
+	size_t data_len, data_cap;
+	struct intern_entry *entries; /* entries[0] is unused */
+	uint32_t count, entries_cap;
+	uint32_t *slots;
+	uint32_t mask;
+};
+
+/* Not a string: out of memory. */
+#define INTERN_NONE 0
+
+/* Sets up an empty table with the given number of slots, a power of two.
+ * Returns 0 if out of memory. */
+int intern_init(struct intern *table, uint32_t slots);
+void intern_destroy(struct intern *table);
+
+/* Room for up to len bytes at the end of the buffer, where the next string
+ * is written before it is committed. Returns NULL if out of memory. */
+char *intern_reserve(struct intern *table, unsigned int len);
+
+/* ID of the len bytes written to the reserved room, which are kept only if
+ * they are not in the table yet. Returns INTERN_NONE if out of memory. */
+uint32_t intern_commit(struct intern *table, unsigned int len);
+
+/* Contents of a string, and its length if len is not NULL, or NULL if
+ * there is no such ID. */
+const char *intern_get(struct intern *table, uint32_t id, unsigned int *len);
@@ -0,0 +1,264 @@
+/* libpasta -- an AST parser for Pascal
+ * Copyright (C) 2024 Dani Rodríguez <dani@danirod.es>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "memscan.h"
+
+#if defined(__GNUC__) \
+    && (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)))
+#define MEMSCAN_X86
+#include <immintrin.h>
+#endif
+
+#ifndef MEMSCAN_X86
+
+static int
+is_space(char ch)
+{
+	return ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n';
+}
+
+static size_t
+scalar_find(const char *buf, size_t pos, char ch)
+{
+	while (buf[pos] != ch && buf[pos] != 0) {
+		pos++;
+	}
+	return pos;
+}
+
+static size_t
+scalar_skip_spaces(const char *buf, size_t pos)
+{
+	while (is_space(buf[pos])) {
+		pos++;
+	}
+	return pos;
+}
+
+static size_t
+scalar_newlines(const char *buf, size_t pos, unsigned int *offsets)
+{
+	size_t count = 0;
+
+	for (; buf[pos] != 0; pos++) {
+		if (buf[pos] == '\n') {
+			if (offsets) {
+				offsets[count] = pos;
+			}
+			count++;
+		}
+	}
+	return count;
+}
+
+static const struct memscan scalar = {
+    "scalar",
+    scalar_find,
+    scalar_skip_spaces,
+    scalar_newlines,
+};
+
+#else
+
+/*
+ * The vector versions compare a whole block against the bytes they look
+ * for and turn the result into a bitmask with one bit per byte. The lowest
+ * bit in the stop mask is where a search ends. Newlines are counted with
+ * popcount over their mask, and only walked bit by bit when their offsets
+ * are wanted. The sentinel always stops the search, so a block never
+ * starts after it and the last load reads at most 31 bytes beyond it.
+ */
+static unsigned int
+below(unsigned int stop)
+{
+	return (1u << __builtin_ctz(stop)) - 1;
+}
+
+static size_t
+store_newlines(unsigned int *offsets, size_t base, unsigned int mask)
+{
+	size_t count = 0;
+
+	if (!offsets) {
+		return __builtin_popcount(mask);
+	}
+	while (mask) {
+		offsets[count++] = base + __builtin_ctz(mask);
+		mask &= mask - 1;
+	}
+	return count;
+}
+
+static size_t
+sse2_find(const char *buf, size_t pos, char ch)
+{
+	const __m128i needle = _mm_set1_epi8(ch);
+	const __m128i zero = _mm_setzero_si128();
+	__m128i block;
+	unsigned int stop;
+
+	for (;; pos += 16) {
+		block = _mm_loadu_si128((const __m128i *) (buf + pos));
+		stop = _mm_movemask_epi8(
+		    _mm_or_si128(_mm_cmpeq_epi8(block, needle),
+		                 _mm_cmpeq_epi8(block, zero)));
+		if (stop) {
+			return pos + __builtin_ctz(stop);
+		}
+	}
+}
+
+static size_t
+sse2_skip_spaces(const char *buf, size_t pos)
+{
+	const __m128i space = _mm_set1_epi8(' ');
+	const __m128i tab = _mm_set1_epi8('\t');
+	const __m128i cr = _mm_set1_epi8('\r');
+	const __m128i newline = _mm_set1_epi8('\n');
+	__m128i block, blank;
+	unsigned int stop;
+
+	for (;; pos += 16) {
+		block = _mm_loadu_si128((const __m128i *) (buf + pos));
+		blank = _mm_or_si128(
+		    _mm_or_si128(_mm_cmpeq_epi8(block, space),
+		                 _mm_cmpeq_epi8(block, tab)),
+		    _mm_or_si128(_mm_cmpeq_epi8(block, cr),
+		                 _mm_cmpeq_epi8(block, newline)));
+		stop = ~_mm_movemask_epi8(blank) & 0xFFFF;
+		if (stop) {
+			return pos + __builtin_ctz(stop);
+		}
+	}
+}
+
+static size_t
+sse2_newlines(const char *buf, size_t pos, unsigned int *offsets)
+{
+	const __m128i newline = _mm_set1_epi8('\n');
+	const __m128i zero = _mm_setzero_si128();
+	__m128i block;
+	unsigned int stop, nl;
+	size_t count = 0;
+
+	for (;; pos += 16) {
+		block = _mm_loadu_si128((const __m128i *) (buf + pos));
+		stop = _mm_movemask_epi8(_mm_cmpeq_epi8(block, zero));
+		nl = _mm_movemask_epi8(_mm_cmpeq_epi8(block, newline));
+		if (stop) {
+			nl &= below(stop);
+		}
+		count += store_newlines(offsets ? offsets + count : 0, pos, nl);
+		if (stop) {
+			return count;
+		}
+	}
+}
+
+static const struct memscan sse2 = {
+    "sse2",
+    sse2_find,
+    sse2_skip_spaces,
+    sse2_newlines,
+};
+
+__attribute__((target("avx2"))) static size_t
+avx2_find(const char *buf, size_t pos, char ch)
+{
+	const __m256i needle = _mm256_set1_epi8(ch);
+	const __m256i zero = _mm256_setzero_si256();
+	__m256i block;
+	unsigned int stop;
+
+	for (;; pos += 32) {
+		block = _mm256_loadu_si256((const __m256i *) (buf + pos));
+		stop = _mm256_movemask_epi8(
+		    _mm256_or_si256(_mm256_cmpeq_epi8(block, needle),
+		                    _mm256_cmpeq_epi8(block, zero)));
+		if (stop) {
+			return pos + __builtin_ctz(stop);
+		}
+	}
+}
+
+__attribute__((target("avx2"))) static size_t
+avx2_skip_spaces(const char *buf, size_t pos)
+{
+	const __m256i space = _mm256_set1_epi8(' ');
+	const __m256i tab = _mm256_set1_epi8('\t');
+	const __m256i cr = _mm256_set1_epi8('\r');
+	const __m256i newline = _mm256_set1_epi8('\n');
+	__m256i block, blank;
+	unsigned int stop;
+
+	for (;; pos += 32) {
+		block = _mm256_loadu_si256((const __m256i *) (buf + pos));
+		blank = _mm256_or_si256(
+		    _mm256_or_si256(_mm256_cmpeq_epi8(block, space),
+		                    _mm256_cmpeq_epi8(block, tab)),
+		    _mm256_or_si256(_mm256_cmpeq_epi8(block, cr),
+		                    _mm256_cmpeq_epi8(block, newline)));
+		stop = ~_mm256_movemask_epi8(blank);
+		if (stop) {
+			return pos + __builtin_ctz(stop);
+		}
+	}
+}
+
+__attribute__((target("avx2"))) static size_t
+avx2_newlines(const char *buf, size_t pos, unsigned int *offsets)
+{
+	const __m256i newline = _mm256_set1_epi8('\n');
+	const __m256i zero = _mm256_setzero_si256();
+	__m256i block;
+	unsigned int stop, nl;
+	size_t count = 0;
+
+	for (;; pos += 32) {
+		block = _mm256_loadu_si256((const __m256i *) (buf + pos));
+		stop = _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, zero));
+		nl = _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, newline));
+		if (stop) {
+			nl &= below(stop);
+		}
+		count += store_newlines(offsets ? offsets + count : 0, pos, nl);
+		if (stop) {
+			return count;
+		}
+	}
+}
+
+static const struct memscan avx2 = {
+    "avx2",
+    avx2_find,
+    avx2_skip_spaces,
+    avx2_newlines,
+};
+
+#endif
+
+const struct memscan *
+memscan_select(void)
+{
+#ifdef MEMSCAN_X86
+	if (__builtin_cpu_supports("avx2")) {
+		return &avx2;
+	}
+	return &sse2;
+#else
+	return &scalar;
+#endif
+}
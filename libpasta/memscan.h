@@ -0,0 +1,49 @@
+/* libpasta -- an AST parser for Pascal
+ * Copyright (C) 2024 Dani Rodríguez <dani@danirod.es>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <stddef.h>
+
+/*
+ * Bulk byte searches used by the scanner to skip whitespace and comments
+ * and to find where lines start. There is a plain C implementation and, on
+ * x86, SSE2 and AVX2 versions that look at 16 or 32 bytes per iteration.
+ * memscan_select() picks the best one supported by the running CPU.
+ *
+ * The buffers are sentinel-padded like the scanner ones: a NUL byte ends
+ * the input and is followed by at least MEMSCAN_OVERREAD readable bytes,
+ * so the searches never compare against a length. Every search starts at
+ * buf[pos] and stops at the NUL at the latest.
+ */
+
+#define MEMSCAN_OVERREAD 32
+
+struct memscan {
+	const char *name;
+
+	/* offset of the first byte equal to ch or NUL. */
+	size_t (*find)(const char *buf, size_t pos, char ch);
+
+	/* offset of the first byte that is not a space, tab, CR or LF. */
+	size_t (*skip_spaces)(const char *buf, size_t pos);
+
+	/* number of newlines before the NUL. unless offsets is NULL, the
+	 * offset of each one is stored there in order. */
+	size_t (*newlines)(const char *buf, size_t pos, unsigned int *offsets);
+};
+
+const struct memscan *memscan_select(void);
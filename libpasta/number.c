@@ -0,0 +1,208 @@
+/* libpasta -- an AST parser for Pascal
+ * Copyright (C) 2024 Dani Rodríguez <dani@danirod.es>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#define _GNU_SOURCE /* strtod_l */
+#include "number.h"
+#include <locale.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define NUMBER_SWAR
+#endif
+
+static int
+is_digit(char ch)
+{
+	return ch >= '0' && ch <= '9';
+}
+
+#ifdef NUMBER_SWAR
+
+/*
+ * Integers are read eight digits at a time by loading them as a single
+ * 64-bit word. After checking that every byte is a digit, three multiply
+ * and shift steps combine the bytes into pairs, the pairs into groups of
+ * four, and the groups into the value of the eight digits.
+ */
+static int
+swar_all_digits(uint64_t word)
+{
+	return ((word & 0xF0F0F0F0F0F0F0F0ULL)
+	        | (((word + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL)
+	           >> 4))
+	       == 0x3333333333333333ULL;
+}
+
+static uint32_t
+swar_eight_digits(uint64_t word)
+{
+	word = (word & 0x0F0F0F0F0F0F0F0FULL) * 2561 >> 8;
+	word = (word & 0x00FF00FF00FF00FFULL) * 6553601 >> 16;
+	return (uint32_t) ((word & 0x0000FFFF0000FFFFULL) * 42949672960001ULL
+	                   >> 32);
+}
+
+#endif
+
+/* Adds the digits at the start of text to the right of value, and returns
+ * how many of them there were. Sets overflow if value no longer fits. */
+static unsigned int
+read_digits(const char *text, unsigned int len, uint64_t *value, int *overflow)
+{
+	unsigned int i = 0;
+	uint64_t v = *value;
+
+#ifdef NUMBER_SWAR
+	uint64_t word;
+
+	for (; i + 8 <= len; i += 8) {
+		memcpy(&word, text + i, 8);
+		if (!swar_all_digits(word)) {
+			break;
+		}
+		if (__builtin_mul_overflow(v, 100000000, &v)
+		    || __builtin_add_overflow(v, swar_eight_digits(word), &v)) {
+			*overflow = 1;
+		}
+	}
+#endif
+	for (; i < len && is_digit(text[i]); i++) {
+		if (__builtin_mul_overflow(v, 10, &v)
+		    || __builtin_add_overflow(v, text[i] - '0', &v)) {
+			*overflow = 1;
+		}
+	}
+
+	*value = v;
+	return i;
+}
+
+static const double powers[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+#define MAX_EXACT_POWER 22
+#define MAX_EXACT_MANTISSA (1ULL << 53)
+
+static locale_t c_locale;
+static pthread_once_t c_locale_once = PTHREAD_ONCE_INIT;
+
+static void
+init_c_locale(void)
+{
+	c_locale = newlocale(LC_NUMERIC_MASK, "C", (locale_t) 0);
+}
+
+/* Correctly rounded conversion for the cases the fast path cannot handle.
+ * The C locale makes sure the decimal separator is always a dot. */
+static double
+slow_real(const char *text, unsigned int len)
+{
+	char local[64], *copy = local;
+	double real;
+
+	if (len >= sizeof(local) && (copy = malloc(len + 1)) == NULL) {
+		return NAN;
+	}
+	memcpy(copy, text, len);
+	copy[len] = 0;
+
+	pthread_once(&c_locale_once, init_c_locale);
+	if (c_locale != (locale_t) 0) {
+		real = strtod_l(copy, NULL, c_locale);
+	} else {
+		real = strtod(copy, NULL);
+	}
+
+	if (copy != local) {
+		free(copy);
+	}
+	return real;
+}
+
+/*
+ * Reals take a fast path when every digit fits in a double mantissa and
+ * the power of ten is exact as a double too: a single multiplication or
+ * division then gives the correctly rounded result, since both operands
+ * are exact. That covers most literals written by hand. The rest go
+ * through strtod.
+ */
+int
+number_parse(const char *text, unsigned int len, number_t *number)
+{
+	uint64_t mantissa = 0, exponent = 0;
+	int overflow = 0, exp_overflow = 0, negative = 0;
+	unsigned int i, digits;
+	long power = 0;
+	double real;
+
+	if ((i = read_digits(text, len, &mantissa, &overflow)) == 0) {
+		return 0;
+	}
+	if (i == len) {
+		number->flags = overflow ? NUMBER_OVERFLOW : 0;
+		number->value.integer = mantissa;
+		return 1;
+	}
+
+	if (text[i] == '.') {
+		digits = read_digits(text + i + 1, len - i - 1, &mantissa,
+		                     &overflow);
+		if (digits == 0) {
+			return 0;
+		}
+		i += digits + 1;
+		power = -(long) digits;
+	}
+	if (i < len && (text[i] == 'e' || text[i] == 'E')) {
+		i++;
+		if (i < len && (text[i] == '+' || text[i] == '-')) {
+			negative = text[i++] == '-';
+		}
+		digits = read_digits(text + i, len - i, &exponent,
+		                     &exp_overflow);
+		if (digits == 0) {
+			return 0;
+		}
+		i += digits;
+		if (exponent > MAX_EXACT_POWER * 2) {
+			exp_overflow = 1; // way out of the fast path anyway
+		}
+		power += negative ? -(long) exponent : (long) exponent;
+	}
+	if (i != len) {
+		return 0;
+	}
+
+	if (!overflow && !exp_overflow && mantissa <= MAX_EXACT_MANTISSA
+	    && power >= -MAX_EXACT_POWER && power <= MAX_EXACT_POWER) {
+		real = (double) mantissa;
+		real = power < 0 ? real / powers[-power] : real * powers[power];
+	} else {
+		real = slow_real(text, len);
+	}
+
+	number->flags = NUMBER_REAL;
+	if (isinf(real)) {
+		number->flags |= NUMBER_OVERFLOW;
+	}
+	number->value.real = real;
+	return 1;
+}
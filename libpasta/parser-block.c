@@ -1,7 +1,8 @@
 #include <parser.h>
-#include <stdlib.h>
 
-static int parser_block_prologue(token_t *token);
+static int parser_block_prologue(tokentype_t type);
+static int declaration_sync(tokentype_t type);
+static expr_t *declaration(parser_t *parser, expr_t *(*rule)(parser_t *));
 
 static expr_t *constblock(parser_t *parser);
 static expr_t *constexpression(parser_t *parser);
@@ -10,37 +11,56 @@ static expr_t *typeexpression(parser_t *parser);
 static expr_t *varblock(parser_t *parser);
 static expr_t *varexpression(parser_t *parser);
 static expr_t *functionproc(parser_t *parser);
-static expr_t *beginblock(parser_t *parser);
-static token_t *newsemi();
-
+static expr_t *procedureheading(parser_t *parser);
+static expr_t *functionheading(parser_t *parser);
+
+/*
+ * A part of the block with an error, such as the heading of a procedure,
+ * is skipped up to the next part. Errors in declarations and statements
+ * are recovered from closer to them, see declaration and parser_statement.
+ */
 expr_t *
 parser_block(parser_t *parser)
 {
-	token_t *token;
-	expr_t *root, *next;
-
-	root = new_binary(newsemi(), NULL, NULL);
-	next = root;
+	token_t token;
+	unsigned int start = parser_list_start(parser);
+	volatile unsigned int mark = start;
+	jmp_buf env, *outer = parser->recover;
+
+	if (setjmp(env)) {
+		parser->list_len = mark;
+		parser_skip_to(parser, parser_block_prologue);
+		if (parser_peek(parser).type == TOK_EOF) {
+			parser->recover = outer;
+			return expr_kind(new_list(parser, token_none, start),
+			                 NODE_BLOCK);
+		}
+	}
+	parser->recover = &env;
 
+	/* The parts of the block, in the order they come. */
 	for (;;) {
+		mark = parser_list_start(parser);
 		token = parser_peek(parser);
-		switch (token->type) {
+		switch (token.type) {
 		case TOK_CONST:
-			next->exp_left = constblock(parser);
+			parser_list_push(parser, constblock(parser));
 			break;
 		case TOK_TYPE:
-			next->exp_left = typeblock(parser);
+			parser_list_push(parser, typeblock(parser));
 			break;
 		case TOK_VAR:
-			next->exp_left = varblock(parser);
+			parser_list_push(parser, varblock(parser));
 			break;
 		case TOK_FUNCTION:
 		case TOK_PROCEDURE:
-			next->exp_left = functionproc(parser);
+			parser_list_push(parser, functionproc(parser));
 			break;
 		case TOK_BEGIN:
-			next->exp_left = beginblock(parser);
-			return root;
+			parser_list_push(parser, parser_statement(parser));
+			parser->recover = outer;
+			return expr_kind(new_list(parser, token_none, start),
+			                 NODE_BLOCK);
 		case TOK_EOF:
 			parser_error(parser,
 			             token,
@@ -48,26 +68,13 @@ parser_block(parser_t *parser)
 		default:
 			parser_error(parser, token, "Token invalid at block");
 		}
-
-		/* So there is another part on this block. */
-		next->exp_right = new_binary(newsemi(), NULL, NULL);
-		next = next->exp_right;
 	}
 }
 
-static token_t *
-newsemi()
-{
-	token_t *tok = malloc(sizeof(token_t));
-	tok->type = TOK_SEMICOLON;
-	tok->meta = NULL;
-	return tok;
-}
-
 static int
-parser_block_prologue(token_t *token)
+parser_block_prologue(tokentype_t type)
 {
-	switch (token->type) {
+	switch (type) {
 	case TOK_CONST:
 	case TOK_TYPE:
 	case TOK_VAR:
@@ -81,170 +88,182 @@ parser_block_prologue(token_t *token)
 	}
 }
 
+static int
+declaration_sync(tokentype_t type)
+{
+	return type == TOK_SEMICOLON || parser_block_prologue(type);
+}
+
+/*
+ * A declaration and the semicolon after it. A declaration with an error is
+ * skipped up to the semicolon after it, or up to the next part of the block
+ * if there is none, and NULL is given instead.
+ */
+static expr_t *
+declaration(parser_t *parser, expr_t *(*rule)(parser_t *))
+{
+	unsigned int mark = parser_list_start(parser);
+	jmp_buf env, *outer = parser->recover;
+	expr_t *decl;
+
+	if (setjmp(env)) {
+		parser->list_len = mark;
+		parser_skip_to(parser, declaration_sync);
+		if (parser_peek(parser).type == TOK_SEMICOLON) {
+			parser_token(parser);
+		}
+		decl = NULL;
+	} else {
+		parser->recover = &env;
+		decl = rule(parser);
+		parser_token_expect(parser, TOK_SEMICOLON);
+	}
+	parser->recover = outer;
+	return decl;
+}
+
 static expr_t *
 constblock(parser_t *parser)
 {
-	token_t *constroot, *semicolon, *peek;
-	expr_t *root, *next;
+	token_t constroot, peek;
+	unsigned int start;
 
 	constroot = parser_token_expect(parser, TOK_CONST);
-	root = new_binary(constroot, NULL, NULL);
-	next = root;
+	start = parser_list_start(parser);
 
 	for (;;) {
-		next->exp_left = constexpression(parser);
-		semicolon = parser_token_expect(parser, TOK_SEMICOLON);
+		parser_list_push(parser, declaration(parser, constexpression));
 
 		/* Check if we done. */
 		peek = parser_peek(parser);
-		if (parser_block_prologue(peek)) {
-			return root;
+		if (parser_block_prologue(peek.type)) {
+			return expr_kind(new_list(parser, constroot, start),
+			                 NODE_CONST_BLOCK);
 		}
-
-		/* Prepare for the next constant to assign. */
-		next->exp_right = new_binary(semicolon, NULL, NULL);
-		next = next->exp_right;
 	}
 }
 
 static expr_t *
 constexpression(parser_t *parser)
 {
-	token_t *equal;
+	token_t equal;
 	expr_t *ident, *constant;
 
 	ident = parser_identifier(parser);
 	equal = parser_token_expect(parser, TOK_EQUAL);
 	constant = parser_constant(parser);
-	return new_binary(equal, ident, constant);
+	return expr_kind(new_binary(parser, equal, ident, constant),
+	                 NODE_CONST_DECL);
 }
 
 static expr_t *
 typeblock(parser_t *parser)
 {
-	token_t *constroot, *semicolon, *peek;
-	expr_t *root, *next;
+	token_t constroot, peek;
+	unsigned int start;
 
 	constroot = parser_token_expect(parser, TOK_TYPE);
-	root = new_binary(constroot, NULL, NULL);
-	next = root;
+	start = parser_list_start(parser);
 
 	for (;;) {
-		next->exp_left = typeexpression(parser);
-		semicolon = parser_token_expect(parser, TOK_SEMICOLON);
+		parser_list_push(parser, declaration(parser, typeexpression));
 
 		/* Check if we done. */
 		peek = parser_peek(parser);
-		if (parser_block_prologue(peek)) {
-			return root;
+		if (parser_block_prologue(peek.type)) {
+			return expr_kind(new_list(parser, constroot, start),
+			                 NODE_TYPE_BLOCK);
 		}
-
-		/* Prepare for the next constant to assign. */
-		next->exp_right = new_binary(semicolon, NULL, NULL);
-		next = next->exp_right;
 	}
 }
 
 static expr_t *
 typeexpression(parser_t *parser)
 {
-	token_t *equal;
+	token_t equal;
 	expr_t *ident, *constant;
 
 	ident = parser_identifier(parser);
 	equal = parser_token_expect(parser, TOK_EQUAL);
 	constant = parser_type(parser);
-	return new_binary(equal, ident, constant);
+	return expr_kind(new_binary(parser, equal, ident, constant),
+	                 NODE_TYPE_DECL);
 }
 
 static expr_t *
 varblock(parser_t *parser)
 {
-	token_t *vartoken, *semicolon, *peek;
-	expr_t *root, *next;
+	token_t vartoken, peek;
+	unsigned int start;
 
 	vartoken = parser_token_expect(parser, TOK_VAR);
-	root = new_binary(vartoken, NULL, NULL);
-	next = root;
+	start = parser_list_start(parser);
 
 	for (;;) {
-		next->exp_left = varexpression(parser);
-		semicolon = parser_token_expect(parser, TOK_SEMICOLON);
+		parser_list_push(parser, declaration(parser, varexpression));
 
 		/* Are we done? */
 		peek = parser_peek(parser);
-		if (parser_block_prologue(peek)) {
-			return root;
+		if (parser_block_prologue(peek.type)) {
+			return expr_kind(new_list(parser, vartoken, start),
+			                 NODE_VAR_BLOCK);
 		}
-
-		/* Prepare for next. */
-		next->exp_right = new_binary(semicolon, NULL, NULL);
-		next = next->exp_right;
 	}
 }
 
 static expr_t *
 varexpression(parser_t *parser)
 {
-	token_t *colon;
+	token_t colon;
 	expr_t *identifiers, *type;
 
 	identifiers = parser_identifier_list(parser);
 	colon = parser_token_expect(parser, TOK_COLON);
 	type = parser_type(parser);
-	return new_binary(colon, identifiers, type);
+	return expr_kind(new_binary(parser, colon, identifiers, type),
+	                 NODE_VAR_DECL);
 }
 
 static expr_t *
 functionproc(parser_t *parser)
 {
-	expr_t *block, *ident, *parlist, *prototype;
-	token_t *keyword;
+	expr_t *block, *prototype;
+	token_t keyword;
 
-	/* Read the function prototype. */
+	/* Read the function prototype, which is recovered from as if it was
+	 * a declaration, so that the block is parsed even if it is wrong. */
 	keyword = parser_token(parser);
-	ident = parser_identifier(parser);
-	parlist = parser_parameter_list(parser);
-	prototype = new_binary(ident->token, parlist, NULL);
-
-	if (keyword->type == TOK_FUNCTION) {
-		/* Take the return type and add it to the prototype. */
-		parser_token_expect(parser, TOK_COLON);
-		prototype->exp_right = parser_type(parser);
+	if (keyword.type == TOK_FUNCTION) {
+		prototype = declaration(parser, functionheading);
+	} else {
+		prototype = declaration(parser, procedureheading);
 	}
-
-	parser_token_expect(parser, TOK_SEMICOLON);
 	block = parser_block(parser);
 	parser_token_expect(parser, TOK_SEMICOLON);
 
-	return new_binary(keyword, prototype, block);
+	return expr_kind(new_binary(parser, keyword, prototype, block),
+	                 keyword.type == TOK_FUNCTION ? NODE_FUNCTION
+	                                              : NODE_PROCEDURE);
 }
 
 static expr_t *
-beginblock(parser_t *parser)
+procedureheading(parser_t *parser)
 {
-	token_t *begin, *separator;
-	expr_t *root, *next;
+	expr_t *ident, *parlist;
 
-	begin = parser_token_expect(parser, TOK_BEGIN);
-	root = new_unary(begin, NULL);
-	next = root;
+	ident = parser_identifier(parser);
+	parlist = parser_parameter_list(parser);
+	return expr_kind(new_binary(parser, ident->token, parlist, NULL),
+	                 NODE_PROTOTYPE);
+}
 
-	for (;;) {
-		next->exp_left = parser_statement(parser);
+static expr_t *
+functionheading(parser_t *parser)
+{
+	expr_t *prototype = procedureheading(parser);
 
-		separator = parser_token(parser);
-		switch (separator->type) {
-		case TOK_SEMICOLON:
-			next->exp_right = new_binary(separator, NULL, NULL);
-			next = next->exp_right;
-			break;
-		case TOK_END:
-			return root;
-		default:
-			parser_error(parser,
-			             separator,
-			             "Unexpected character here");
-		}
-	}
+	/* Take the return type and add it to the prototype. */
+	parser_token_expect(parser, TOK_COLON);
+	prototype->exp_right = parser_type(parser);
+	return prototype;
 }
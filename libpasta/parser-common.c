@@ -21,16 +21,18 @@
  * a token of the given type. if the token is not of such type, it will
  * fail.
  */
-token_t *
+token_t
 parser_token_expect(parser_t *parser, tokentype_t type)
 {
-	token_t *token;
+	token_t token;
 
-	token = parser_token(parser);
-	if (token->type != type) {
+	/* a wrong token is left for the rule that recovers from the error,
+	 * since it may be where the next statement or declaration starts. */
+	token = parser_peek(parser);
+	if (token.type != type) {
 		parser_error(parser, token, "Token is not of expected type");
 	}
-	return token;
+	return parser_token(parser);
 }
 
 /**
@@ -49,22 +51,25 @@ expr_t *
 parser_identifier_list(parser_t *parser)
 {
 	expr_t *root = NULL, *next;
-	token_t *token;
+	token_t token;
 
 	for (;;) {
 		/* Consume the next identifier and add it to the linked list. */
 		token = parser_token_expect(parser, TOK_IDENTIFIER);
 		if (!root) {
-			root = new_unary(token, NULL);
+			root = expr_kind(new_unary(parser, token, NULL),
+			                 NODE_IDENTIFIER_LIST);
 			next = root;
 		} else {
-			next->exp_left = new_unary(token, NULL);
+			next->exp_left =
+			    expr_kind(new_unary(parser, token, NULL),
+			              NODE_IDENTIFIER_LIST);
 			next = next->exp_left;
 		}
 
 		/* Are there more tokens to parse? */
 		token = parser_peek(parser);
-		if (token->type != TOK_COMMA) {
+		if (token.type != TOK_COMMA) {
 			break;
 		}
 		parser_token_expect(parser, TOK_COMMA);
@@ -28,13 +28,16 @@
 expr_t *
 parser_unsigned_constant(parser_t *parser)
 {
-	token_t *token = parser_token(parser);
-	switch (token->type) {
+	token_t token = parser_token(parser);
+	switch (token.type) {
 	case TOK_STRING:
+		return expr_kind(new_literal(parser, token), NODE_STRING);
 	case TOK_NIL:
+		return expr_kind(new_literal(parser, token), NODE_NIL);
 	case TOK_DIGIT:
+		return expr_kind(new_literal(parser, token), NODE_NUMBER);
 	case TOK_IDENTIFIER:
-		return new_literal(token);
+		return expr_kind(new_literal(parser, token), NODE_IDENTIFIER);
 	default:
 		parser_error(parser, token, "Token is of invalid type");
 	}
@@ -52,10 +55,11 @@ parser_unsigned_constant(parser_t *parser)
 expr_t *
 parser_constant(parser_t *parser)
 {
-	token_t *token, *sign;
+	token_t token, sign;
+	expr_t *constant;
 
 	token = parser_peek(parser);
-	switch (token->type) {
+	switch (token.type) {
 	case TOK_STRING:
 	case TOK_NIL:
 	case TOK_IDENTIFIER:
@@ -75,10 +79,14 @@ parser_constant(parser_t *parser)
 	/* If we reach here, is because token is PLUS or MINUS. */
 	sign = parser_token(parser);
 	token = parser_token(parser);
-	switch (token->type) {
+	switch (token.type) {
 	case TOK_IDENTIFIER:
 	case TOK_DIGIT:
-		return new_unary(sign, new_literal(token));
+		constant = expr_kind(new_literal(parser, token),
+		                     token.type == TOK_DIGIT ? NODE_NUMBER
+		                                             : NODE_IDENTIFIER);
+		return expr_kind(new_unary(parser, sign, constant),
+		                 NODE_UNARY_OP);
 	default:
 		parser_error(parser,
 		             token,
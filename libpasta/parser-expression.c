@@ -15,40 +15,52 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 #include "parser.h"
+#include <stdlib.h>
 
-static int simex_follows_plusminus(parser_t *parser);
-static expr_t *clean_expression(expr_t *expression);
+/*
+ * Binding strength of the operators. Relational operators bind the loosest,
+ * then the adding operators, then the multiplying ones, and a NOT binds
+ * tighter than any of them. A sign in front of a simple expression applies
+ * to its first term, so it is an adding operator with no left operand.
+ * Brackets bind looser than anything, so operators are never joined across
+ * the bracket they are in.
+ */
+#define PREC_CALL (-2)
+#define PREC_GROUP (-1)
+#define PREC_NONE 0
+#define PREC_RELATIONAL 1
+#define PREC_ADDING 2
+#define PREC_MULTIPLYING 3
+#define PREC_NOT 4
 
 /*
- * Expression node for an expression.
- *
- * These kind of nodes represents the lowest operator precedende for an entire
- * expression tree. It is one or two simple expressions, which have a higher
- * precedence. If there are two simple expressions, they will be linked by an
- * operator: < > <= >= = <>.
- *
- * For expressions that are only made of simple expressions, the node will be a
- * grouping with the inner simple expression. Such is the case for "3":
- *
- * - GROUPING: The simple expression for "3"
- *
- * When the expression has two simple expressions joined by an operator, the
- * node will be a binary, with the operator as token and both operands as left
- * and right child. This is the case for "x > 4":
+ * Operators and brackets waiting for what comes after them while parsing
+ * an expression. An operator is only pushed once every operator with the
+ * same or a higher precedence has been reduced, so between two brackets
+ * the precedences are strictly increasing and there is at most one
+ * operator per level, but for a run of NOTs.
  *
- * - BINARY (GREATER)
- *   - GROUPING: The simple expression that represents x
- *   - GROUPING: The simple expression that represents 4
+ * A bracket also keeps what the expression around it was parsing, and a
+ * call keeps where its arguments start on the list stack, where each one
+ * is pushed once it ends, see parser_list_start.
  */
-expr_t *
-parser_expression(parser_t *parser)
-{
-	expr_t *expr, *second;
-	token_t *token;
+struct pending {
+	token_t op;
+	int prec;
+	expr_t *left; /* NULL for a sign or a NOT */
 
-	expr = parser_simple_expression(parser);
-	token = parser_peek(parser);
-	switch (token->type) {
+	token_t callee;
+	unsigned int start;
+	int lowest, relational;
+};
+
+static expr_t *factor_atom(parser_t *parser);
+static int simex_follows_plusminus(parser_t *parser);
+
+static int
+binary_precedence(token_t token)
+{
+	switch (token.type) {
 	case TOK_GREATER:
 	case TOK_GREATEQL:
 	case TOK_LESSER:
@@ -56,177 +68,352 @@ parser_expression(parser_t *parser)
 	case TOK_EQUAL:
 	case TOK_NEQUAL:
 	case TOK_IN:
-		parser_token(parser);
-		second = parser_simple_expression(parser);
-		return new_binary(token, expr, second);
+		return PREC_RELATIONAL;
+	case TOK_PLUS:
+	case TOK_MINUS:
+	case TOK_OR:
+		return PREC_ADDING;
+	case TOK_ASTERISK:
+	case TOK_SLASH:
+	case TOK_DIV:
+	case TOK_MOD:
+	case TOK_AND:
+		return PREC_MULTIPLYING;
 	default:
-		return clean_expression(new_grouping(expr));
+		return PREC_NONE;
+	}
+}
+
+/* Counts one more level of nesting, which is an error past max_depth. */
+static void
+nest(parser_t *parser, token_t token)
+{
+	if (parser->max_depth && parser->expr_depth >= parser->max_depth) {
+		parser_error(parser, token, "Expressions nested too deeply");
 	}
+	parser->expr_depth++;
+}
+
+static struct pending *
+push_pending(parser_t *parser, token_t op, int prec, expr_t *left)
+{
+	struct pending *pending, *top;
+	unsigned int cap;
+
+	if (prec < PREC_NONE) {
+		nest(parser, op);
+	}
+	if (parser->pending_len == parser->pending_cap) {
+		cap = parser->pending_cap ? parser->pending_cap * 2 : 16;
+		pending = realloc(parser->pending, sizeof(*pending) * cap);
+		if (pending == NULL) {
+			parser_error(parser, op, "Out of memory");
+		}
+		parser->pending = pending;
+		parser->pending_cap = cap;
+	}
+	top = &parser->pending[parser->pending_len++];
+	top->op = op;
+	top->prec = prec;
+	top->left = left;
+	return top;
 }
 
 /*
- * Expression nodes for the simple expression.
+ * Pushes the signs, NOTs and brackets in front of the next factor. The
+ * expression inside a bracket starts anew, so the bracket keeps what the
+ * expression around it was parsing until it is closed.
+ */
+static void
+push_prefixes(parser_t *parser,
+              unsigned int base,
+              int *lowest,
+              int *relational)
+{
+	struct pending *top;
+	token_t token;
+	int prec;
+
+	for (;;) {
+		token = parser_peek(parser);
+		prec = parser->pending_len > base
+		           ? parser->pending[parser->pending_len - 1].prec
+		           : PREC_GROUP;
+		if (*lowest <= PREC_ADDING && simex_follows_plusminus(parser)
+		    && (prec < PREC_NONE || prec == PREC_RELATIONAL)) {
+			parser_token(parser);
+			if (simex_follows_plusminus(parser)) {
+				parser_error(parser, token, "double operator");
+			}
+			push_pending(parser, token, PREC_ADDING, NULL);
+			continue;
+		}
+
+		switch (token.type) {
+		case TOK_NOT:
+			parser_token(parser);
+			push_pending(parser, token, PREC_NOT, NULL);
+			continue;
+		case TOK_LPAREN:
+			parser_token(parser);
+			top = push_pending(parser, token, PREC_GROUP, NULL);
+			break;
+		case TOK_IDENTIFIER:
+			if (parser_peek_far(parser, 1).type != TOK_LPAREN) {
+				return;
+			}
+			parser_token(parser);
+			top = push_pending(parser,
+			                   parser_token(parser),
+			                   PREC_CALL,
+			                   NULL);
+			top->callee = token;
+			top->start = parser_list_start(parser);
+			break;
+		default:
+			return;
+		}
+		top->lowest = *lowest;
+		top->relational = *relational;
+		*lowest = PREC_RELATIONAL;
+		*relational = 0;
+	}
+}
+
+/* Joins the operands pushed after base to the operators in front of them,
+ * while those bind as tight as prec or tighter. */
+static expr_t *
+reduce(parser_t *parser, unsigned int base, int prec, expr_t *operand)
+{
+	struct pending *top;
+
+	while (parser->pending_len > base
+	       && parser->pending[parser->pending_len - 1].prec >= prec) {
+		top = &parser->pending[--parser->pending_len];
+		if (top->left == NULL) {
+			operand = expr_kind(new_unary(parser, top->op, operand),
+			                    NODE_UNARY_OP);
+		} else {
+			operand = expr_kind(
+			    new_binary(parser, top->op, top->left, operand),
+			    NODE_BINARY_OP);
+		}
+	}
+	return operand;
+}
+
+/*
+ * Ends the expression inside the bracket on top of the stack with the
+ * token that follows it. Returns the group or the call that the bracket
+ * makes, or NULL if a comma goes on to the next argument of the call.
+ */
+static expr_t *
+close_bracket(parser_t *parser, expr_t *operand)
+{
+	struct pending *top = &parser->pending[parser->pending_len - 1];
+	expr_t *args;
+	token_t token;
+
+	if (top->prec == PREC_GROUP) {
+		parser_token_expect(parser, TOK_RPAREN);
+		operand = expr_kind(new_grouping(parser, operand),
+		                    NODE_GROUPING);
+		operand->token = top->op;
+		return operand;
+	}
+
+	token = parser_token(parser);
+	if (token.type != TOK_RPAREN && token.type != TOK_COMMA) {
+		parser_error(parser, token, "Expected ) or ,");
+	}
+	parser_list_push(parser, operand);
+	if (token.type == TOK_COMMA) {
+		return NULL;
+	}
+	args = expr_kind(new_list(parser, top->op, top->start), NODE_ARGUMENTS);
+	return expr_kind(new_unary(parser, top->callee, args), NODE_CALL);
+}
+
+/*
+ * Parses operators of the given precedence or higher, and the factors
+ * between them, without recursing once per operator or per parenthesis.
+ * Every operator is left associative: the operands read so far are joined
+ * as soon as an operator that binds as loose or looser follows them, so
+ * "1 - 2 - 3" is (1 - 2) - 3. Only one relational operator is taken per
+ * expression, since they cannot be chained; the caller will find the
+ * second one.
  *
- * A simple expression contains one or more terms, which have higher precedende
- * than simple expressions, separated between + - and OR.  In a similar fashion
- * to other members of a global expression tree, it is either a grouping of a
- * term, or a binary of two terms with the operator as an apex.
+ * A group or the arguments of a call are whole expressions, parsed in the
+ * same loop after pushing the parenthesis that opens them, and closed by
+ * the parenthesis that ends them.
+ */
+static expr_t *
+parse_operators(parser_t *parser, int lowest)
+{
+	unsigned int base = parser->pending_len;
+	int relational = 0, prec;
+	struct pending *top;
+	expr_t *operand;
+	token_t token;
+
+	nest(parser, parser_peek(parser));
+	for (;;) {
+		push_prefixes(parser, base, &lowest, &relational);
+		operand = factor_atom(parser);
+
+		/* join the operands that bind tighter than the operator after
+		 * them, and close the brackets that end with them. */
+		for (;;) {
+			token = parser_peek(parser);
+			prec = binary_precedence(token);
+			if (prec < lowest
+			    || (prec == PREC_RELATIONAL && relational)) {
+				prec = PREC_NONE;
+			}
+			operand = reduce(parser, base, prec, operand);
+			if (prec != PREC_NONE) {
+				break;
+			}
+			if (parser->pending_len == base) {
+				parser->expr_depth--;
+				return operand;
+			}
+			operand = close_bracket(parser, operand);
+			if (operand == NULL) {
+				/* and on to the next argument. */
+				relational = 0;
+				break;
+			}
+			top = &parser->pending[--parser->pending_len];
+			lowest = top->lowest;
+			relational = top->relational;
+			parser->expr_depth--;
+		}
+		if (prec == PREC_NONE) {
+			continue;
+		}
+
+		parser_token(parser);
+		if (prec == PREC_RELATIONAL) {
+			relational = 1;
+		} else if (prec == PREC_ADDING
+		           && simex_follows_plusminus(parser)) {
+			parser_error(parser, token, "double operator");
+		}
+		push_pending(parser, token, prec, operand);
+	}
+}
+
+/*
+ * Expression node for an expression.
  *
- * The oddity in simple expressions is that they optionally accept a plus and a
- * minus in front of the first term. To simplify the operation, at the moment
- * if the first element is one of these optional operators, we take it out and
- * yield an unary of the prefix and the remaining expression.
+ * These kind of nodes represents the lowest operator precedende for an entire
+ * expression tree. It is one or two simple expressions, which have a higher
+ * precedence. If there are two simple expressions, they will be linked by an
+ * operator: < > <= >= = <>.
  *
- * As an example, for the simple expression "2", you get the following:
+ * An expression made of a single factor is that factor, with no node around
+ * it. Such is the case for "3":
  *
- * - GROUPING: the term that represents "2"
+ * - LITERAL (3)
  *
- * For the simple expression "2 + 3", you get the following:
+ * Operators are binary nodes, with the operator as token and both operands
+ * as left and right child, and the precedence of the operators is given by
+ * the shape of the tree. This is the case for "x > 4 + y":
  *
- * - BINARY (PLUS)
- *   - GROUPING: The term that represents 2
- *   - GROUPING: The term that represents 3
+ * - BINARY (GREATER)
+ *   - LITERAL (x)
+ *   - BINARY (PLUS)
+ *     - LITERAL (4)
+ *     - LITERAL (y)
+ *
+ * Parenthesis are kept as a GROUPING around the expression inside them.
+ */
+expr_t *
+parser_expression(parser_t *parser)
+{
+	return parse_operators(parser, PREC_RELATIONAL);
+}
+
+/*
+ * Expression nodes for the simple expression.
  *
- * Multiple terms form nested binary nodes, such as "1 + 2 + 3":
+ * A simple expression contains one or more terms, which have higher precedende
+ * than simple expressions, separated between + - and OR. Operators of the same
+ * precedence are left associative, so "1 + 2 + 3" is:
  *
  * - BINARY (PLUS)
- *   - GROUPING: The term that represents 1
  *   - BINARY (PLUS)
- *     - GROUPING: The term that represents 2
- *     - GROUPING: The term that represents 3
+ *     - LITERAL (1)
+ *     - LITERAL (2)
+ *   - LITERAL (3)
  *
- * In the following case, the expression is "-4 + 2 OR 3":
+ * The oddity in simple expressions is that they optionally accept a plus and a
+ * minus in front of the first term. It is an unary over that first term, so
+ * for "-4 + 2 OR 3" you get the following:
  *
- * - UNARY (-)
+ * - BINARY (OR)
  *   - BINARY (PLUS)
- *     - GROUPING: The term that represents 4
- *     - BINARY (OR)
- *       - GROUPING: The term that represents 2
- *       - GROUPING: The term that represents 3
+ *     - UNARY (-)
+ *       - LITERAL (4)
+ *     - LITERAL (2)
+ *   - LITERAL (3)
  */
 expr_t *
 parser_simple_expression(parser_t *parser)
 {
-	expr_t *expr;
-	token_t *token;
-
-	/* Unwrap a plus minus prefix. Note that in the graphs this is
-	 * represented as an arrow before the first node. To make this easier to
-	 * solve, I do this recursively. However, keep in mind that no two
-	 * consecutive operators are allowed, so we must check that a valid term
-	 * symbol follows the prefix. */
-	if (simex_follows_plusminus(parser)) {
-		token = parser_token(parser);
-		if (simex_follows_plusminus(parser)) {
-			parser_error(parser, token, "double operator");
-		}
-		return new_unary(token, parser_simple_expression(parser));
-	}
-
-	expr = parser_term(parser);
-	token = parser_peek(parser);
-	switch (token->type) {
-	case TOK_PLUS:
-	case TOK_MINUS:
-	case TOK_OR:
-		parser_token(parser);
-		if (simex_follows_plusminus(parser)) {
-			parser_error(parser, token, "double operator");
-		}
-		return new_binary(token,
-		                  expr,
-		                  parser_simple_expression(parser));
-	default:
-		return clean_expression(new_grouping(expr));
-	}
+	return parse_operators(parser, PREC_ADDING);
 }
 
 /*
- * [factor] = GROUPING(f)
+ * [factor] = f
  * [f1] * [f2] = BINARY(*, f1, f2)
  * [f1] * [f2] / [f3] = BINARY(/, BINARY(*, f1, f2), f3)
  */
 expr_t *
 parser_term(parser_t *parser)
 {
-	expr_t *factor;
-	token_t *token;
-
-	factor = parser_factor(parser);
-	token = parser_peek(parser);
-	switch (token->type) {
-	case TOK_ASTERISK:
-	case TOK_SLASH:
-	case TOK_DIV:
-	case TOK_MOD:
-	case TOK_AND:
-		parser_token(parser);
-		return new_binary(token, factor, parser_term(parser));
-	default:
-		return clean_expression(new_grouping(factor));
-	}
-}
-
-/*
- * Extracts the comma separated list of expressions between brackets
- * in the IDENTIFIER branch of the FACTOR expression tree.
- */
-static expr_t *
-factor_id_expression_list(parser_t *parser)
-{
-	token_t *token;
-	expr_t *root, *next;
-
-	token = parser_token_expect(parser, TOK_LPAREN);
-	root = new_binary(token, parser_expression(parser), NULL);
-	next = root;
-
-	for (;;) {
-		token = parser_token(parser);
-		switch (token->type) {
-		case TOK_RPAREN:
-			next->exp_right = new_literal(token);
-			return root;
-		case TOK_COMMA:
-			next->exp_right =
-			    new_binary(token, parser_expression(parser), NULL);
-			next = next->exp_right;
-			break;
-		default:
-			parser_error(parser, token, "Expected ) or ,");
-		}
-	}
+	return parse_operators(parser, PREC_MULTIPLYING);
 }
 
 static expr_t *
 factor_id_set(parser_t *parser)
 {
-	token_t *token;
+	token_t token;
 	expr_t *root, *next;
 
 	token = parser_token_expect(parser, TOK_LBRACKET);
-	root = new_binary(token, parser_expression(parser), NULL);
+	root = expr_kind(
+	    new_binary(parser, token, parser_expression(parser), NULL),
+	    NODE_SET);
 	next = root;
 
 	for (;;) {
 		token = parser_token(parser);
 
 		/* Check if it is the end of a range. */
-		if (token->type == TOK_DOTDOT) {
-			next->exp_left = new_binary(token,
-			                            next->exp_left,
-			                            parser_expression(parser));
+		if (token.type == TOK_DOTDOT) {
+			next->exp_left =
+			    expr_kind(new_binary(parser,
+			                         token,
+			                         next->exp_left,
+			                         parser_expression(parser)),
+			              NODE_RANGE);
 			token = parser_token(parser);
 		}
 
 		/* Is this the end? */
-		switch (token->type) {
+		switch (token.type) {
 		case TOK_RBRACKET:
-			next->exp_right = new_literal(token);
+			next->exp_right = new_literal(parser, token);
 			return root;
 		case TOK_COMMA:
 			next->exp_right =
-			    new_binary(token, parser_expression(parser), NULL);
+			    expr_kind(new_binary(parser,
+			                         token,
+			                         parser_expression(parser),
+			                         NULL),
+			              NODE_SET);
 			next = next->exp_right;
 			break;
 		default:
@@ -235,27 +422,32 @@ factor_id_set(parser_t *parser)
 	}
 }
 
+/*
+ * A factor, with the NOTs in front of it. Parentheses and calls are parsed
+ * by parse_operators, and the rest of the factors by factor_atom.
+ */
 expr_t *
 parser_factor(parser_t *parser)
 {
-	token_t *token, *token2;
+	return parse_operators(parser, PREC_NOT);
+}
+
+/* A factor that is not a NOT, a group or a call. */
+static expr_t *
+factor_atom(parser_t *parser)
+{
+	token_t token;
 	expr_t *expr;
 
 	token = parser_peek(parser);
-	switch (token->type) {
+	switch (token.type) {
 	case TOK_IDENTIFIER:
-		token2 = parser_peek_far(parser, 1);
-		switch (token2->type) {
+		switch (parser_peek_far(parser, 1).type) {
 		case TOK_LBRACKET:
 		case TOK_DOT:
 		case TOK_CARET:
 			expr = parser_variable(parser);
 			break;
-		case TOK_LPAREN:
-			parser_token(parser);
-			expr =
-			    new_unary(token, factor_id_expression_list(parser));
-			break;
 		default:
 			expr = parser_unsigned_constant(parser);
 		}
@@ -265,15 +457,6 @@ parser_factor(parser_t *parser)
 	case TOK_STRING:
 		expr = parser_unsigned_constant(parser);
 		break;
-	case TOK_NOT:
-		parser_token_expect(parser, TOK_NOT);
-		expr = new_unary(token, parser_factor(parser));
-		break;
-	case TOK_LPAREN:
-		parser_token(parser);
-		expr = parser_expression(parser);
-		parser_token_expect(parser, TOK_RPAREN);
-		break;
 	case TOK_LBRACKET:
 		expr = factor_id_set(parser);
 		break;
@@ -288,20 +471,6 @@ parser_factor(parser_t *parser)
 static int
 simex_follows_plusminus(parser_t *parser)
 {
-	token_t *token = parser_peek(parser);
-	return token->type == TOK_PLUS || token->type == TOK_MINUS;
-}
-
-static expr_t *
-clean_expression(expr_t *expr)
-{
-	expr_t *nested;
-
-	if (expr->type == GROUPING && expr->exp_left->type == GROUPING) {
-		nested = expr->exp_left;
-		expr_free(expr);
-		return clean_expression(nested);
-	}
-
-	return expr;
+	token_t token = parser_peek(parser);
+	return token.type == TOK_PLUS || token.type == TOK_MINUS;
 }
@@ -19,19 +19,23 @@
 static expr_t *parser_field_list_branch(parser_t *parser);
 static expr_t *parse_constant_list(parser_t *parser);
 
-/* TODO: How does this work? */
+/*
+ * A field list is a LIST with a node for every [idents] : [type] line,
+ * followed, if there is a variant part, by the node for the case line and
+ * then by a node for every one of its branches.
+ */
 expr_t *
 parser_field_list(parser_t *parser)
 {
-	expr_t *root = NULL, *next;
+	unsigned int start = parser_list_start(parser);
 	expr_t *left, *idents, *type;
-	token_t *token, *tokenpeek;
+	token_t token, tokenpeek;
 
 	/* Stage 1: normal fields list. */
 	for (;;) {
 		/* is a new identifier incoming? */
 		token = parser_peek(parser);
-		if (token->type != TOK_IDENTIFIER) {
+		if (token.type != TOK_IDENTIFIER) {
 			break;
 		}
 
@@ -43,7 +47,7 @@ parser_field_list(parser_t *parser)
 		/* get the identifier list separated by commas. */
 		idents = parser_identifier_list(parser);
 		token = parser_token(parser);
-		if (token->type != TOK_COLON) {
+		if (token.type != TOK_COLON) {
 			parser_error(parser,
 			             token,
 			             "COLON expected after field list");
@@ -51,27 +55,22 @@ parser_field_list(parser_t *parser)
 		type = parser_type(parser);
 
 		/* craft the node and add it to the list. */
-		left = new_binary(token, idents, type);
-
-		if (!root) {
-			root = new_binary(NULL, left, NULL);
-			next = root;
-		} else {
-			next->exp_right = new_binary(NULL, left, NULL);
-			next = next->exp_right;
-		}
+		left = expr_kind(new_binary(parser, token, idents, type),
+		                 NODE_FIELD);
+		parser_list_push(parser, left);
 
 		/* there may be a semicolon here. */
 		token = parser_peek(parser);
-		if (token->type != TOK_SEMICOLON) {
-			return root;
+		if (token.type != TOK_SEMICOLON) {
+			return expr_kind(new_list(parser, token_none, start),
+			                 NODE_FIELD_LIST);
 		}
 		parser_token_expect(parser, TOK_SEMICOLON);
 	}
 
 	/* Stage 2: case line -- if there is one at all. */
 	token = parser_peek(parser);
-	if (token->type == TOK_CASE) {
+	if (token.type == TOK_CASE) {
 		parser_token_expect(parser, TOK_CASE);
 
 		/* two choices: [case x : t of] or [case t of]
@@ -80,7 +79,7 @@ parser_field_list(parser_t *parser)
 		 * case, if that identifier is followed by : there is
 		 * another one, else should be an of. */
 		token = parser_token(parser);
-		if (token->type != TOK_IDENTIFIER) {
+		if (token.type != TOK_IDENTIFIER) {
 			parser_error(parser,
 			             token,
 			             "Expected an identifier following "
@@ -88,14 +87,25 @@ parser_field_list(parser_t *parser)
 		}
 
 		tokenpeek = parser_token(parser);
-		switch (tokenpeek->type) {
+		switch (tokenpeek.type) {
 		case TOK_OF: /* [case t of] */
-			left = new_unary(tokenpeek, new_literal(token));
+			left = expr_kind(
+			    new_unary(parser,
+			              tokenpeek,
+			              expr_kind(new_literal(parser, token),
+			                        NODE_IDENTIFIER)),
+			    NODE_VARIANT);
 			break;
 		case TOK_COLON: /* [case x : t of] */
-			left = new_binary(tokenpeek, NULL, new_literal(token));
+			left = expr_kind(
+			    new_binary(parser,
+			               tokenpeek,
+			               NULL,
+			               expr_kind(new_literal(parser, token),
+			                         NODE_IDENTIFIER)),
+			    NODE_VARIANT);
 			token = parser_token(parser);
-			if (token->type != TOK_IDENTIFIER) {
+			if (token.type != TOK_IDENTIFIER) {
 				parser_error(parser,
 				             token,
 				             "Expected an identifier following "
@@ -103,13 +113,14 @@ parser_field_list(parser_t *parser)
 			}
 
 			tokenpeek = parser_token(parser);
-			if (tokenpeek->type != TOK_OF) {
+			if (tokenpeek.type != TOK_OF) {
 				parser_error(parser,
 				             token,
 				             "Expected OF after secondd token");
 			}
 			left->token = tokenpeek;
-			left->exp_left = new_literal(token);
+			left->exp_left = expr_kind(new_literal(parser, token),
+			                           NODE_IDENTIFIER);
 			break;
 		default:
 			parser_error(parser,
@@ -117,38 +128,29 @@ parser_field_list(parser_t *parser)
 			             "Expected either a COLON or OF");
 		}
 
-		if (!root) {
-			root = new_binary(NULL, left, NULL);
-			next = root;
-		} else {
-			next->exp_right = new_binary(NULL, left, NULL);
-			next = next->exp_right;
-		}
+		parser_list_push(parser, left);
 
 		/* and now comes a list of possible values for this case
 		 * with their field lists. it is mandatory to have at
 		 * least one, but there may be more. */
-		left = parser_field_list_branch(parser);
-		next->exp_right = new_binary(NULL, left, NULL);
-		next = next->exp_right;
+		parser_list_push(parser, parser_field_list_branch(parser));
 
 		for (;;) {
 			/* if a semicolon continues, there is still
 			 * more. */
 			token = parser_peek(parser);
-			if (token->type != TOK_SEMICOLON) {
+			if (token.type != TOK_SEMICOLON) {
 				break;
 			}
 
 			/* wait, there's more */
 			parser_token_expect(parser, TOK_SEMICOLON);
-			left = parser_field_list_branch(parser);
-			next->exp_right = new_binary(NULL, left, NULL);
-			next = next->exp_right;
+			parser_list_push(parser,
+			                 parser_field_list_branch(parser));
 		}
-	} // closes if (token->type == TOK_CASE)
+	} // closes if (token.type == TOK_CASE)
 
-	if (root == NULL) {
+	if (parser_list_start(parser) == start) {
 		/* there should be at least something, either a field or
 		 * a case
 		 */
@@ -158,30 +160,24 @@ parser_field_list(parser_t *parser)
 		             "There should be either IDENT or CASE");
 	}
 
-	return root;
+	return expr_kind(new_list(parser, token_none, start), NODE_FIELD_LIST);
 }
 
 static expr_t *
 parse_constant_list(parser_t *parser)
 {
-	expr_t *root = NULL, *next, *constant;
-	token_t *token;
+	unsigned int start = parser_list_start(parser);
+	token_t token;
 
 	for (;;) {
-		/* parse the constant and add it to the chain. */
-		constant = parser_constant(parser);
-		if (!root) {
-			root = new_binary(NULL, constant, NULL);
-			next = root;
-		} else {
-			next->exp_right = new_binary(NULL, constant, NULL);
-			next = next->exp_right;
-		}
+		/* parse the constant and add it to the list. */
+		parser_list_push(parser, parser_constant(parser));
 
 		/* check if there are more tokens to parse. */
 		token = parser_peek(parser);
-		if (token->type != TOK_COMMA) {
-			return root;
+		if (token.type != TOK_COMMA) {
+			return expr_kind(new_list(parser, token_none, start),
+			                 NODE_CASE_LABELS);
 		}
 		parser_token_expect(parser, TOK_COMMA);
 	}
@@ -191,16 +187,17 @@ static expr_t *
 parser_field_list_branch(parser_t *parser)
 {
 	expr_t *constant, *fields;
-	token_t *token;
+	token_t token;
 
 	constant = parse_constant_list(parser);
 	token = parser_token(parser);
-	if (token->type != TOK_COLON) {
+	if (token.type != TOK_COLON) {
 		parser_error(parser, token, "Expected a COLON here");
 	}
 	parser_token_expect(parser, TOK_LPAREN);
 	fields = parser_field_list(parser);
 	parser_token_expect(parser, TOK_RPAREN);
 
-	return new_binary(token, constant, fields);
+	return expr_kind(new_binary(parser, token, constant, fields),
+	                 NODE_VARIANT_BRANCH);
 }
\ No newline at end of file
@@ -86,8 +86,8 @@ parser_parameter_list(parser_t *parser)
 {
 	expr_t *root = NULL;
 
-	if (parser_peek(parser)->type == TOK_LPAREN) {
-		if (parser_peek_far(parser, 1)->type != TOK_RPAREN) {
+	if (parser_peek(parser).type == TOK_LPAREN) {
+		if (parser_peek_far(parser, 1).type != TOK_RPAREN) {
 			root = do_parse_parameter_list(parser);
 		}
 	}
@@ -98,7 +98,7 @@ parser_parameter_list(parser_t *parser)
 static expr_t *
 do_parse_parameter_list(parser_t *parser)
 {
-	token_t *token;
+	token_t token;
 	expr_t *root = NULL, *next;
 
 	/* Apex of the entire parameter list structure. */
@@ -107,10 +107,13 @@ do_parse_parameter_list(parser_t *parser)
 	for (;;) {
 		/* Advance the chain. */
 		if (root == NULL) {
-			root = new_binary(token, NULL, NULL);
+			root = expr_kind(new_binary(parser, token, NULL, NULL),
+			                 NODE_PARAMETERS);
 			next = root;
 		} else {
-			next->exp_right = new_binary(token, NULL, NULL);
+			next->exp_right =
+			    expr_kind(new_binary(parser, token, NULL, NULL),
+			              NODE_PARAMETERS);
 			next = next->exp_right;
 		}
 
@@ -119,11 +122,11 @@ do_parse_parameter_list(parser_t *parser)
 
 		/* Parse right child. */
 		token = parser_token(parser);
-		if (token->type == TOK_RPAREN) {
+		if (token.type == TOK_RPAREN) {
 			/* We done. */
-			next->exp_right = new_literal(token);
+			next->exp_right = new_literal(parser, token);
 			break;
-		} else if (token->type != TOK_SEMICOLON) {
+		} else if (token.type != TOK_SEMICOLON) {
 			parser_error(parser, token, "Expected ) or ;");
 		}
 
@@ -139,18 +142,20 @@ do_parse_parameter_list(parser_t *parser)
 static expr_t *
 do_parse_idtype_block(parser_t *parser)
 {
-	token_t *type;
+	token_t type;
 	expr_t *parlist, *var = NULL;
 
-	if (parser_peek(parser)->type == TOK_VAR)
-		var = new_literal(parser_token(parser));
+	if (parser_peek(parser).type == TOK_VAR)
+		var = new_literal(parser, parser_token(parser));
 	parlist = parser_identifier_list(parser);
 	parser_token_expect(parser, TOK_COLON);
 	type = parser_token_expect(parser, TOK_IDENTIFIER);
 
 	if (var == NULL) {
-		return new_unary(type, parlist);
+		return expr_kind(new_unary(parser, type, parlist),
+		                 NODE_PARAMETER_GROUP);
 	} else {
-		return new_binary(type, var, parlist);
+		return expr_kind(new_binary(parser, type, var, parlist),
+		                 NODE_PARAMETER_GROUP);
 	}
 }
@@ -6,7 +6,7 @@ static expr_t *progparam(parser_t *parser);
 expr_t *
 parser_program(parser_t *parser)
 {
-	token_t *programkw;
+	token_t programkw;
 	expr_t *ident, *block;
 
 	programkw = parser_token_expect(parser, TOK_PROGRAM);
@@ -15,18 +15,19 @@ parser_program(parser_t *parser)
 	block = parser_block(parser);
 	parser_token_expect(parser, TOK_DOT);
 
-	return new_binary(programkw, ident, block);
+	return expr_kind(new_binary(parser, programkw, ident, block),
+	                 NODE_PROGRAM);
 }
 
 static expr_t *
 progident(parser_t *parser)
 {
 	expr_t *ident;
-	token_t *token;
+	token_t token;
 
 	ident = parser_identifier(parser);
 	token = parser_peek(parser);
-	if (token->type == TOK_LPAREN) {
+	if (token.type == TOK_LPAREN) {
 		/* elevate the identifier into a unary tree. */
 		ident->type = UNARY;
 		ident->exp_left = progparam(parser);
@@ -38,7 +39,7 @@ static expr_t *
 progparam(parser_t *parser)
 {
 	expr_t *root = NULL, *next;
-	token_t *peek;
+	token_t peek;
 
 	parser_token_expect(parser, TOK_LPAREN);
 	for (;;) {
@@ -52,7 +53,7 @@ progparam(parser_t *parser)
 		}
 
 		peek = parser_peek(parser);
-		switch (peek->type) {
+		switch (peek.type) {
 		/* another iteration. */
 		case TOK_COMMA:
 			parser_token_expect(parser, TOK_COMMA);
@@ -19,14 +19,15 @@
 expr_t *
 parser_simple_type(parser_t *parser)
 {
-	token_t *next_symbol, *next_id;
+	token_t next_symbol, next_id;
 	expr_t *root, *next_node;
 
 	next_symbol = parser_peek(parser);
-	if (next_symbol->type == TOK_LPAREN) {
+	if (next_symbol.type == TOK_LPAREN) {
 		next_symbol = parser_token_expect(parser, TOK_LPAREN);
 		// Branch 2 - (identifiers separated by commas inside brackets)
-		root = new_binary(next_symbol, NULL, NULL);
+		root = expr_kind(new_binary(parser, next_symbol, NULL, NULL),
+		                 NODE_ENUM_TYPE);
 		next_node = root;
 
 		while (1) {
@@ -35,12 +36,14 @@ parser_simple_type(parser_t *parser)
 
 			// Pick what goes on the right branch
 			next_symbol = parser_token(parser);
-			if (next_symbol->type == TOK_RPAREN) {
-				next_node->exp_right = new_literal(next_symbol);
-				break;
-			} else if (next_symbol->type == TOK_COMMA) {
+			if (next_symbol.type == TOK_RPAREN) {
 				next_node->exp_right =
-				    new_binary(next_symbol, NULL, NULL);
+				    new_literal(parser, next_symbol);
+				break;
+			} else if (next_symbol.type == TOK_COMMA) {
+				next_node->exp_right = expr_kind(
+				    new_binary(parser, next_symbol, NULL, NULL),
+				    NODE_ENUM_TYPE);
 				next_node = next_node->exp_right;
 			} else {
 				parser_error(parser,
@@ -51,21 +54,26 @@ parser_simple_type(parser_t *parser)
 	} else {
 		next_node = parser_constant(parser);
 		next_symbol = parser_peek(parser);
-		if (next_symbol->type == TOK_DOTDOT) {
+		if (next_symbol.type == TOK_DOTDOT) {
 			// Branch 3 - (two identifiers between a ..)
 			next_symbol = parser_token_expect(parser, TOK_DOTDOT);
-			root = new_binary(next_symbol, NULL, NULL);
+			root = expr_kind(
+			    new_binary(parser, next_symbol, NULL, NULL),
+			    NODE_SUBRANGE_TYPE);
 			root->exp_left = next_node;
 			root->exp_right = parser_constant(parser);
-		} else if (next_symbol->type == TOK_LBRACKET) {
+		} else if (next_symbol.type == TOK_LBRACKET) {
 			next_symbol = parser_token_expect(parser, TOK_LBRACKET);
-			root = new_binary(next_symbol, NULL, NULL);
+			root = expr_kind(
+			    new_binary(parser, next_symbol, NULL, NULL),
+			    NODE_SIZED_TYPE);
 			root->exp_left = next_node;
 			root->exp_right = parser_expression(parser);
 			parser_token_expect(parser, TOK_RBRACKET);
 		} else {
 			// Branch 1 - identifier alone
-			root = new_grouping(next_node);
+			root = expr_kind(new_grouping(parser, next_node),
+			                 NODE_TYPE_NAME);
 		}
 	}
 
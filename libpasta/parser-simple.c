@@ -34,30 +34,29 @@
 expr_t *
 parser_identifier(parser_t *parser)
 {
-	return new_literal(parser_token_expect(parser, TOK_IDENTIFIER));
+	token_t token = parser_token_expect(parser, TOK_IDENTIFIER);
+	return expr_kind(new_literal(parser, token), NODE_IDENTIFIER);
 }
 
 expr_t *
 parser_unsigned_number(parser_t *parser)
 {
-	return new_literal(parser_token_expect(parser, TOK_DIGIT));
+	token_t token = parser_token_expect(parser, TOK_DIGIT);
+	return expr_kind(new_literal(parser, token), NODE_NUMBER);
 }
 
 expr_t *
 parser_unsigned_integer(parser_t *parser)
 {
-	token_t *token;
-	char *value;
+	token_t token;
+	const number_t *number;
 
 	token = parser_token_expect(parser, TOK_DIGIT);
-	if (!token->meta)
+	number = scanner_number(parser->scanner, &token);
+	if (!number)
 		parser_error(parser, token, "TOK_DIGIT has no meta value");
-	value = token->meta;
-	while (*value) {
-		if (*value < '0' || *value > '9')
-			parser_error(parser, token, "Expected an integer");
-		value++;
-	}
+	if (number->flags & NUMBER_REAL)
+		parser_error(parser, token, "Expected an integer");
 
-	return new_literal(token);
+	return expr_kind(new_literal(parser, token), NODE_NUMBER);
 }
@@ -16,29 +16,156 @@
  */
 #include "parser.h"
 #include "token.h"
+#include <stdlib.h>
 
+/*
+ * Statements nest other statements, and code written by a program can nest
+ * them thousands of levels deep. Instead of recursing into parser_statement
+ * for a nested statement, the statement around it is pushed to a stack in
+ * the parser as a frame saying where it was left, and the loop in
+ * parser_statement parses the nested statement and then hands it back.
+ */
+enum stmt_state {
+	STMT_BEGIN,  /* statements of BEGIN ... END */
+	STMT_THEN,   /* IF cond THEN stmt */
+	STMT_ELSE,   /* IF cond THEN stmt ELSE stmt */
+	STMT_REPEAT, /* statements of REPEAT ... UNTIL */
+	STMT_UNTIL,  /* REPEAT ... UNTIL cond */
+	STMT_WHILE,  /* WHILE cond DO stmt */
+	STMT_FOR,    /* FOR control DO stmt */
+	STMT_CASE,   /* labels : stmt, of CASE expr OF ... END */
+	STMT_WITH,   /* WITH variables DO stmt */
+};
+
+struct stmt_frame {
+	enum stmt_state state;
+	token_t token;  /* keyword of the statement */
+	token_t token2; /* THEN, ELSE, UNTIL or the colon of a case item */
+	expr_t *left;   /* what the statement has before the nested one */
+	expr_t *right;  /* THEN branch or labels of the case item */
+	unsigned int start; /* list of the statements or case items */
+};
+
+static int
+statement_sync(tokentype_t type)
+{
+	switch (type) {
+	case TOK_SEMICOLON:
+	case TOK_END:
+	case TOK_UNTIL:
+	case TOK_ELSE:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+static struct stmt_frame *push_frame(parser_t *parser,
+                                     enum stmt_state state,
+                                     token_t token);
+static expr_t *statement_start(parser_t *parser);
+static int statement_resume(parser_t *parser, expr_t **stmt);
 static int follows_label(parser_t *parser);
 static expr_t *assignment_or_procedure(parser_t *parser);
 static expr_t *assignment(parser_t *parser);
 static expr_t *procedure(parser_t *parser);
 static expr_t *arguments(parser_t *parser);
-static expr_t *ifthen(parser_t *parser);
-static expr_t *begin(parser_t *parser);
-static expr_t *repeat(parser_t *parser);
-static expr_t *repeat_stmts(parser_t *parser);
-static expr_t *whiledo(parser_t *parser);
-static expr_t *forloop(parser_t *parser);
-static expr_t *caseof(parser_t *parser);
-static expr_t *caselist(parser_t *parser);
+static expr_t *for_control(parser_t *parser);
 static expr_t *constlist(parser_t *parser);
-static expr_t *with(parser_t *parser);
+static expr_t *variablelist(parser_t *parser);
 static expr_t *gotostmt(parser_t *parser);
 static expr_t *exitstmt(parser_t *parser);
 
+/*
+ * A statement with an error is skipped up to the next semicolon, END,
+ * UNTIL or ELSE, and the statement around it gets NULL instead, as if it
+ * was empty. An error in the part of a statement after the one nested in
+ * it, such as a missing END, is skipped the same way and that part is
+ * parsed again from there.
+ */
 expr_t *
 parser_statement(parser_t *parser)
 {
-	token_t *peek;
+	unsigned int base = parser->stmt_len, list = parser->list_len;
+	volatile unsigned int depth = base, mark = list;
+	volatile int resuming = 0;
+	jmp_buf env, *outer = parser->recover;
+	expr_t *stmt = NULL;
+
+	if (setjmp(env)) {
+		parser_skip_to(parser, statement_sync);
+		if (parser_peek(parser).type == TOK_EOF) {
+			parser->stmt_len = base;
+			parser->list_len = list;
+			parser->recover = outer;
+			return NULL;
+		}
+		if (!resuming) {
+			parser->stmt_len = depth;
+			parser->list_len = mark;
+		}
+		resuming = 1;
+		stmt = NULL;
+	}
+	parser->recover = &env;
+
+	for (;;) {
+		/* go into nested statements until one that nests nothing. */
+		while (!resuming) {
+			depth = parser->stmt_len;
+			mark = parser->list_len;
+			stmt = statement_start(parser);
+			resuming = parser->stmt_len == depth;
+		}
+
+		/* and give it back to the statements around it, until one of
+		 * them needs another nested statement. */
+		do {
+			if (parser->stmt_len == base) {
+				parser->recover = outer;
+				return stmt;
+			}
+		} while (!statement_resume(parser, &stmt));
+		resuming = 0;
+	}
+}
+
+static struct stmt_frame *
+push_frame(parser_t *parser, enum stmt_state state, token_t token)
+{
+	struct stmt_frame *frames, *frame;
+	unsigned int cap;
+
+	if (parser->max_depth && parser->stmt_len >= parser->max_depth) {
+		parser_error(parser, token, "Statements nested too deeply");
+	}
+	if (parser->stmt_len == parser->stmt_cap) {
+		cap = parser->stmt_cap ? parser->stmt_cap * 2 : 16;
+		frames = realloc(parser->stmt_frames, sizeof(*frames) * cap);
+		if (frames == NULL) {
+			parser_error(parser, token, "Out of memory");
+		}
+		parser->stmt_frames = frames;
+		parser->stmt_cap = cap;
+	}
+	frame = &parser->stmt_frames[parser->stmt_len++];
+	frame->state = state;
+	frame->token = token;
+	frame->start = parser_list_start(parser);
+	return frame;
+}
+
+/*
+ * Parses a statement up to the statement nested in it, if any, and pushes
+ * a frame for the rest. Returns the statement if it has nothing nested,
+ * which is NULL for the empty statement.
+ */
+static expr_t *
+statement_start(parser_t *parser)
+{
+	struct stmt_frame *frame;
+	token_t token, token2;
+	expr_t *expr, *labels;
 
 	if (follows_label(parser)) {
 		// TODO: Need to take the label. Drop it for now.
@@ -46,24 +173,57 @@ parser_statement(parser_t *parser)
 		parser_token(parser);
 	}
 
-	peek = parser_peek(parser);
-	switch (peek->type) {
+	token = parser_peek(parser);
+	switch (token.type) {
 	case TOK_IDENTIFIER:
 		return assignment_or_procedure(parser);
 	case TOK_BEGIN:
-		return begin(parser);
+		parser_token(parser);
+		push_frame(parser, STMT_BEGIN, token);
+		return NULL;
 	case TOK_IF:
-		return ifthen(parser);
+		parser_token(parser);
+		expr = parser_expression(parser);
+		token2 = parser_token_expect(parser, TOK_THEN);
+		frame = push_frame(parser, STMT_THEN, token);
+		frame->token2 = token2;
+		frame->left = expr;
+		return NULL;
 	case TOK_REPEAT:
-		return repeat(parser);
+		parser_token(parser);
+		push_frame(parser, STMT_REPEAT, token);
+		return NULL;
 	case TOK_WHILE:
-		return whiledo(parser);
+		parser_token(parser);
+		expr = parser_expression(parser);
+		parser_token_expect(parser, TOK_DO);
+		frame = push_frame(parser, STMT_WHILE, token);
+		frame->left = expr;
+		return NULL;
 	case TOK_FOR:
-		return forloop(parser);
+		parser_token(parser);
+		expr = for_control(parser);
+		frame = push_frame(parser, STMT_FOR, token);
+		frame->left = expr;
+		return NULL;
 	case TOK_CASE:
-		return caseof(parser);
+		parser_token(parser);
+		expr = parser_expression(parser);
+		parser_token_expect(parser, TOK_OF);
+		labels = constlist(parser);
+		token2 = parser_token_expect(parser, TOK_COLON);
+		frame = push_frame(parser, STMT_CASE, token);
+		frame->token2 = token2;
+		frame->left = expr;
+		frame->right = labels;
+		return NULL;
 	case TOK_WITH:
-		return with(parser);
+		parser_token(parser);
+		expr = variablelist(parser);
+		parser_token_expect(parser, TOK_DO);
+		frame = push_frame(parser, STMT_WITH, token);
+		frame->left = expr;
+		return NULL;
 	case TOK_GOTO:
 		return gotostmt(parser);
 	case TOK_EXIT:
@@ -74,13 +234,139 @@ parser_statement(parser_t *parser)
 	}
 }
 
+/*
+ * Gives the nested statement to the frame on top of the stack. Returns 1
+ * if the frame needs another nested statement. Otherwise the frame is
+ * popped and the statement is replaced with the finished statement of
+ * the frame, and returns 0.
+ */
+static int
+statement_resume(parser_t *parser, expr_t **stmt)
+{
+	struct stmt_frame *frame = &parser->stmt_frames[parser->stmt_len - 1];
+	expr_t *then, *root, *list, *cond;
+	token_t token;
+
+	switch (frame->state) {
+	case STMT_BEGIN:
+		parser_list_push(parser, *stmt);
+		token = parser_token(parser);
+		switch (token.type) {
+		case TOK_SEMICOLON:
+			return 1;
+		case TOK_END:
+			list = new_list(parser, frame->token, frame->start);
+			*stmt = expr_kind(list, NODE_COMPOUND);
+			break;
+		default:
+			parser_error(parser, token, "Unexpected token");
+		}
+		break;
+	case STMT_THEN:
+		then = expr_kind(new_binary(parser, frame->token2, *stmt, NULL),
+		                 NODE_THEN);
+		root = expr_kind(
+		    new_binary(parser, frame->token, frame->left, then),
+		    NODE_IF);
+		*stmt = root;
+
+		token = parser_peek(parser);
+		if (token.type == TOK_ELSE) {
+			parser_token(parser);
+			frame->state = STMT_ELSE;
+			frame->token2 = token;
+			frame->left = root;
+			frame->right = then;
+			return 1;
+		}
+		break;
+	case STMT_ELSE:
+		then = frame->right;
+		then->exp_right =
+		    expr_kind(new_unary(parser, frame->token2, *stmt),
+		              NODE_ELSE);
+		*stmt = frame->left;
+		break;
+	case STMT_REPEAT:
+		parser_list_push(parser, *stmt);
+		token = parser_peek(parser);
+		if (token.type == TOK_SEMICOLON) {
+			parser_token(parser);
+			return 1;
+		} else if (token.type != TOK_UNTIL) {
+			parser_error(parser,
+			             token,
+			             "Expected semicolon or until");
+		}
+		frame->state = STMT_UNTIL;
+		frame->left = expr_kind(
+		    new_list(parser, token_none, frame->start),
+		    NODE_STATEMENTS);
+		frame->token2 = parser_token(parser);
+		*stmt = parser_expression(parser);
+		/* fall through */
+	case STMT_UNTIL:
+		cond = expr_kind(new_unary(parser, frame->token2, *stmt),
+		                 NODE_UNTIL);
+		*stmt = expr_kind(
+		    new_binary(parser, frame->token, frame->left, cond),
+		    NODE_REPEAT);
+		break;
+	case STMT_WHILE:
+		*stmt = expr_kind(
+		    new_binary(parser, frame->token, frame->left, *stmt),
+		    NODE_WHILE);
+		break;
+	case STMT_FOR:
+		*stmt = expr_kind(
+		    new_binary(parser, frame->token, frame->left, *stmt),
+		    NODE_FOR);
+		break;
+	case STMT_WITH:
+		*stmt = expr_kind(
+		    new_binary(parser, frame->token, frame->left, *stmt),
+		    NODE_WITH);
+		break;
+	case STMT_CASE:
+		parser_list_push(
+		    parser,
+		    expr_kind(
+		        new_binary(parser, frame->token2, frame->right, *stmt),
+		        NODE_CASE_ITEM));
+
+		token = parser_token(parser);
+		if (token.type == TOK_SEMICOLON
+		    && parser_peek(parser).type == TOK_END) {
+			// Semicolon and END is valid.
+			token = parser_token(parser);
+		} else if (token.type == TOK_SEMICOLON) {
+			// We have another case. If its labels have an error,
+			// it gets none.
+			frame->right = NULL;
+			frame->right = constlist(parser);
+			frame->token2 = parser_token_expect(parser, TOK_COLON);
+			return 1;
+		} else if (token.type != TOK_END) {
+			parser_error(parser, token, "Unexpected token here");
+		}
+		list = expr_kind(new_list(parser, token_none, frame->start),
+		                 NODE_CASE_LIST);
+		*stmt = expr_kind(
+		    new_binary(parser, frame->token, frame->left, list),
+		    NODE_CASE);
+		break;
+	}
+	parser->stmt_len--;
+	return 0;
+}
+
 static int
 follows_label(parser_t *parser)
 {
-	token_t *label, *colon;
+	token_t label, colon;
 
 	label = parser_peek(parser);
-	switch (label->type) {
+	switch (label.type) {
 	case TOK_IDENTIFIER:
 	case TOK_DIGIT:
 		break;
@@ -89,15 +375,15 @@ follows_label(parser_t *parser)
 	}
 
 	colon = parser_peek_far(parser, 1);
-	return colon->type == TOK_COLON;
+	return colon.type == TOK_COLON;
 }
 
 static expr_t *
 assignment_or_procedure(parser_t *parser)
 {
-	token_t *symbol = parser_peek_far(parser, 1);
+	token_t symbol = parser_peek_far(parser, 1);
 
-	switch (symbol->type) {
+	switch (symbol.type) {
 	case TOK_LBRACKET:
 	case TOK_DOT:
 	case TOK_CARET:
@@ -113,161 +399,58 @@ static expr_t *
 assignment(parser_t *parser)
 {
 	expr_t *variable = parser_variable(parser);
-	token_t *assign = parser_token_expect(parser, TOK_ASSIGN);
+	token_t assign = parser_token_expect(parser, TOK_ASSIGN);
 	expr_t *expr = parser_expression(parser);
-	return new_binary(assign, variable, expr);
+	return expr_kind(new_binary(parser, assign, variable, expr),
+	                 NODE_ASSIGN);
 }
 
 static expr_t *
 procedure(parser_t *parser)
 {
 	expr_t *args, *ident = parser_identifier(parser);
-	token_t *token = parser_peek(parser);
-	if (token->type == TOK_LPAREN) {
+	token_t token = parser_peek(parser);
+	if (token.type == TOK_LPAREN) {
 		/* Arguments of the function call. */
 		args = arguments(parser);
 		if (args != NULL) {
-			return new_binary(token, ident, args);
+			return expr_kind(new_binary(parser, token, ident, args),
+			                 NODE_CALL);
 		}
 	}
-	return ident;
+	return expr_kind(ident, NODE_CALL);
 }
 
 static expr_t *
 arguments(parser_t *parser)
 {
-	token_t *following, *lparen = parser_token_expect(parser, TOK_LPAREN);
-	expr_t *root, *expr, *next;
+	token_t following, lparen = parser_token_expect(parser, TOK_LPAREN);
+	unsigned int start;
 
 	/* If the parenthesis are empty, there are no arguments. */
 	following = parser_peek(parser);
-	if (following->type == TOK_RPAREN) {
+	if (following.type == TOK_RPAREN) {
 		parser_token_expect(parser, TOK_RPAREN);
 		return NULL;
 	}
 
-	root = new_binary(lparen, NULL, NULL);
-	next = root;
+	start = parser_list_start(parser);
 	for (;;) {
-		expr = parser_expression(parser);
-		next->exp_left = expr;
+		parser_list_push(parser, parser_expression(parser));
 
 		following = parser_token(parser);
-		switch (following->type) {
+		switch (following.type) {
 		case TOK_COMMA:
-			next->exp_right = new_binary(following, NULL, NULL);
-			next = next->exp_right;
 			break;
 		case TOK_RPAREN:
-			next->exp_right = new_literal(following);
-			return root;
+			return expr_kind(new_list(parser, lparen, start),
+			                 NODE_ARGUMENTS);
 		default:
 			parser_error(parser, following, "Unexpected argument");
 		}
 	}
 }
 
-static expr_t *
-begin(parser_t *parser)
-{
-	token_t *begin = parser_token_expect(parser, TOK_BEGIN);
-	token_t *following;
-	expr_t *root = new_binary(begin, NULL, NULL);
-	expr_t *next = root;
-
-	for (;;) {
-		next->exp_left = parser_statement(parser);
-		following = parser_token(parser);
-		switch (following->type) {
-		case TOK_SEMICOLON:
-			next->exp_right = new_binary(following, NULL, NULL);
-			next = next->exp_right;
-			break;
-		case TOK_END:
-			next->exp_right = new_literal(following);
-			return root;
-		default:
-			parser_error(parser, following, "Unexpected token");
-		}
-	}
-}
-
-static expr_t *
-ifthen(parser_t *parser)
-{
-	token_t *iftoken = parser_token_expect(parser, TOK_IF);
-	expr_t *condition = parser_expression(parser);
-	token_t *thentoken = parser_token_expect(parser, TOK_THEN);
-	expr_t *iftrue = parser_statement(parser);
-	token_t *maybeelse = parser_peek(parser);
-
-	expr_t *thenbranch = new_binary(thentoken, iftrue, NULL);
-	expr_t *root = new_binary(iftoken, condition, thenbranch);
-
-	if (maybeelse->type == TOK_ELSE) {
-		token_t *elsetoken = parser_token_expect(parser, TOK_ELSE);
-		expr_t *iffalse = parser_statement(parser);
-		thenbranch->exp_right = new_unary(elsetoken, iffalse);
-	}
-
-	return root;
-}
-
-static expr_t *
-repeat(parser_t *parser)
-{
-	token_t *repeattoken = parser_token_expect(parser, TOK_REPEAT);
-	expr_t *statements = repeat_stmts(parser);
-	token_t *untilkw = parser_token_expect(parser, TOK_UNTIL);
-	expr_t *condition = parser_expression(parser);
-	return new_binary(repeattoken,
-	                  statements,
-	                  new_unary(untilkw, condition));
-}
-
-static expr_t *
-repeat_stmts(parser_t *parser)
-{
-	expr_t *root = NULL, *next, *stmt;
-	token_t *token;
-
-	for (;;) {
-		stmt = parser_statement(parser);
-		token = parser_peek(parser);
-		if (token->type == TOK_SEMICOLON) {
-			parser_token_expect(parser, TOK_SEMICOLON);
-			if (root == NULL) {
-				root = new_binary(token, stmt, NULL);
-				next = root;
-			} else {
-				next->exp_right = new_binary(token, stmt, NULL);
-				next = next->exp_right;
-			}
-		} else if (token->type == TOK_UNTIL) {
-			if (root == NULL) {
-				root = new_grouping(stmt);
-			} else {
-				next->exp_right = new_grouping(stmt);
-			}
-			return root;
-		} else {
-			parser_error(parser,
-			             token,
-			             "Expected semicolon or until");
-		}
-	}
-}
-
-static expr_t *
-whiledo(parser_t *parser)
-{
-	token_t *whiletoken = parser_token_expect(parser, TOK_WHILE);
-	expr_t *whileexpr = parser_expression(parser);
-	parser_token_expect(parser, TOK_DO);
-	expr_t *whilestmt = parser_statement(parser);
-	return new_binary(whiletoken, whileexpr, whilestmt);
-}
-
 /*
  * FOR
  * |- <ident>
@@ -275,78 +458,28 @@ whiledo(parser_t *parser)
  * |     |- <start expr>
  * |     |- <end expr>
  * |-<expr>
+ *
+ * This is the <ident> part, up to the DO.
  */
 static expr_t *
-forloop(parser_t *parser)
+for_control(parser_t *parser)
 {
-	token_t *fortoken = parser_token_expect(parser, TOK_FOR);
 	expr_t *ident = parser_identifier(parser);
 	parser_token_expect(parser, TOK_ASSIGN);
 	expr_t *startexpr = parser_expression(parser);
-	token_t *todownto = parser_token(parser);
+	token_t todownto = parser_token(parser);
 	expr_t *endexpr = parser_expression(parser);
 	parser_token_expect(parser, TOK_DO);
-	expr_t *stmt = parser_statement(parser);
 
-	if (todownto->type != TOK_TO && todownto->type != TOK_DOWNTO) {
+	if (todownto.type != TOK_TO && todownto.type != TOK_DOWNTO) {
 		parser_error(parser, todownto, "Expected either TO or DOWNTO");
 	}
 
-	return new_binary(
-	    fortoken,
-	    new_unary(ident->token, new_binary(todownto, startexpr, endexpr)),
-	    stmt);
-}
-
-static expr_t *
-caseof(parser_t *parser)
-{
-	token_t *casetoken = parser_token_expect(parser, TOK_CASE);
-	expr_t *expr = parser_expression(parser);
-	parser_token_expect(parser, TOK_OF);
-	expr_t *cases = caselist(parser);
-	return new_binary(casetoken, expr, cases);
-}
-
-static expr_t *
-caselist(parser_t *parser)
-{
-	expr_t *root = NULL, *next;
-	expr_t *consts, *stmt, *caseitem;
-	token_t *colon, *separator, *peek;
-	for (;;) {
-		consts = constlist(parser);
-		colon = parser_token_expect(parser, TOK_COLON);
-		stmt = parser_statement(parser);
-		caseitem = new_binary(colon, consts, stmt);
-
-		separator = parser_token(parser);
-		if (root == NULL) {
-			root = new_binary(separator, caseitem, NULL);
-			next = root;
-		} else {
-			next->exp_right = new_binary(separator, caseitem, NULL);
-			next = next->exp_right;
-		}
-		switch (separator->type) {
-		case TOK_END:
-			// We are done here.
-			return root;
-		case TOK_SEMICOLON:
-			// Semicolon and END is valid. Check for this.
-			peek = parser_peek(parser);
-			if (peek->type == TOK_END) {
-				parser_token(parser);
-				return root;
-			}
-			// We have another case.
-			break;
-		default:
-			parser_error(parser,
-			             separator,
-			             "Unexpected token here");
-		}
-	}
+	expr_t *range =
+	    expr_kind(new_binary(parser, todownto, startexpr, endexpr),
+	              NODE_FOR_RANGE);
+	return expr_kind(new_unary(parser, ident->token, range),
+	                 NODE_FOR_CONTROL);
 }
 
 static expr_t *
@@ -354,8 +487,8 @@ constlist(parser_t *parser)
 {
 	expr_t *root = NULL, *next;
 	expr_t *constant = parser_constant(parser);
-	token_t *peek = parser_peek(parser);
-	switch (peek->type) {
+	token_t peek = parser_peek(parser);
+	switch (peek.type) {
 	case TOK_COLON:
 		// This is the only const we have, so we return it.
 		return constant;
@@ -368,20 +501,23 @@ constlist(parser_t *parser)
 
 	// If this line is reached, we have more than one const.
 	parser_token_expect(parser, TOK_COMMA);
-	root = new_binary(peek, constant, NULL);
+	root = expr_kind(new_binary(parser, peek, constant, NULL),
+	                 NODE_CASE_LABELS);
 	next = root;
 
 	// Keep reading constants.
 	for (;;) {
 		constant = parser_constant(parser);
 		peek = parser_peek(parser);
-		switch (peek->type) {
+		switch (peek.type) {
 		case TOK_COLON:
 			next->exp_right = constant;
 			return root;
 		case TOK_COMMA:
 			parser_token_expect(parser, TOK_COMMA);
-			next->exp_right = new_binary(peek, constant, NULL);
+			next->exp_right =
+			    expr_kind(new_binary(parser, peek, constant, NULL),
+			              NODE_CASE_LABELS);
 			next = next->exp_right;
 			break;
 		default:
@@ -397,9 +533,9 @@ variablelist(parser_t *parser)
 {
 	expr_t *root = NULL, *next;
 	expr_t *var = parser_variable(parser);
-	token_t *sep = parser_peek(parser);
+	token_t sep = parser_peek(parser);
 
-	switch (sep->type) {
+	switch (sep.type) {
 	case TOK_COMMA:
 		// We have to read more.
 		parser_token(parser);
@@ -411,17 +547,20 @@ variablelist(parser_t *parser)
 		parser_error(parser, sep, "Unexpected token inside WITH");
 	}
 
-	root = new_binary(sep, var, NULL);
+	root = expr_kind(new_binary(parser, sep, var, NULL),
+	                 NODE_WITH_VARIABLES);
 	next = root;
 
 	for (;;) {
 		var = parser_variable(parser);
 		sep = parser_peek(parser);
 
-		switch (sep->type) {
+		switch (sep.type) {
 		case TOK_COMMA:
 			sep = parser_token(parser);
-			next->exp_right = new_binary(sep, var, NULL);
+			next->exp_right =
+			    expr_kind(new_binary(parser, sep, var, NULL),
+			              NODE_WITH_VARIABLES);
 			next = next->exp_right;
 			break;
 		case TOK_DO:
@@ -435,41 +574,32 @@ variablelist(parser_t *parser)
 	}
 }
 
-static expr_t *
-with(parser_t *parser)
-{
-	token_t *withword = parser_token_expect(parser, TOK_WITH);
-	expr_t *variables = variablelist(parser);
-	parser_token_expect(parser, TOK_DO);
-	expr_t *stmt = parser_statement(parser);
-	return new_binary(withword, variables, stmt);
-}
-
 static expr_t *
 gotostmt(parser_t *parser)
 {
-	token_t *gotoword = parser_token_expect(parser, TOK_GOTO);
+	token_t gotoword = parser_token_expect(parser, TOK_GOTO);
 
 	// FIXME: maybe these days labels can be alphanumeric as well
 	expr_t *gotoaddr = parser_unsigned_integer(parser);
-	return new_unary(gotoword, gotoaddr);
+	return expr_kind(new_unary(parser, gotoword, gotoaddr), NODE_GOTO);
 }
 
 static expr_t *
 exitstmt(parser_t *parser)
 {
-	token_t *exitword = parser_token(parser);
+	token_t exitword = parser_token(parser);
 	parser_token_expect(parser, TOK_LPAREN);
 
-	token_t *peek = parser_peek(parser);
+	token_t peek = parser_peek(parser);
 	expr_t *exitparam;
-	if (peek->type == TOK_PROGRAM) {
+	if (peek.type == TOK_PROGRAM) {
 		parser_token(parser);
-		exitparam = new_literal(peek);
+		exitparam = expr_kind(new_literal(parser, peek),
+		                      NODE_IDENTIFIER);
 	} else {
 		exitparam = parser_identifier(parser);
 	}
 
 	parser_token_expect(parser, TOK_RPAREN);
-	return new_unary(exitword, exitparam);
+	return expr_kind(new_unary(parser, exitword, exitparam), NODE_EXIT);
 }
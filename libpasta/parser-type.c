@@ -19,48 +19,54 @@
 expr_t *
 parser_type(parser_t *parser)
 {
-	token_t *next_token, *packed = NULL;
+	token_t next_token, packed = token_none;
 	expr_t *root, *next_expr;
 
 	next_token = parser_peek(parser);
 
-	if (next_token->type == TOK_PACKED) {
+	if (next_token.type == TOK_PACKED) {
 		packed = next_token;
 		parser_token_expect(parser, TOK_PACKED);
 		next_token = parser_peek(parser);
 	}
 
-	switch (next_token->type) {
+	switch (next_token.type) {
 	case TOK_CARET:
-		if (packed) {
+		if (packed.type == TOK_PACKED) {
 			parser_error(parser,
 			             next_token,
 			             "CARET cannot be PACKED");
 		}
-		root = new_unary(next_token, NULL);
+		root = expr_kind(new_unary(parser, next_token, NULL),
+		                 NODE_POINTER_TYPE);
 		parser_token_expect(parser, TOK_CARET);
 		root->exp_left = parser_identifier(parser);
 		break;
 	case TOK_ARRAY:
 		// Consume TOK_ARRAY
-		root = new_binary(next_token, NULL, NULL);
+		root = expr_kind(new_binary(parser, next_token, NULL, NULL),
+		                 NODE_ARRAY_TYPE);
 		parser_token_expect(parser, TOK_ARRAY);
 
 		// Consume the list of simple types that goes between []
 		next_token = parser_token_expect(parser, TOK_LBRACKET);
-		root->exp_left = new_binary(next_token, NULL, NULL);
+		root->exp_left =
+		    expr_kind(new_binary(parser, next_token, NULL, NULL),
+		              NODE_INDEX_TYPES);
 		next_expr = root->exp_left;
 
 		while (1) {
 			next_expr->exp_left = parser_simple_type(parser);
 
 			next_token = parser_token(parser);
-			if (next_token->type == TOK_COMMA) {
-				next_expr->exp_right =
-				    new_binary(next_token, NULL, NULL);
+			if (next_token.type == TOK_COMMA) {
+				next_expr->exp_right = expr_kind(
+				    new_binary(parser, next_token, NULL, NULL),
+				    NODE_INDEX_TYPES);
 				next_expr = next_expr->exp_right;
-			} else if (next_token->type == TOK_RBRACKET) {
-				next_expr->exp_right = new_literal(next_token);
+			} else if (next_token.type == TOK_RBRACKET) {
+				next_expr->exp_right =
+				    new_literal(parser, next_token);
 				break;
 			} else {
 				parser_error(
@@ -75,7 +81,8 @@ parser_type(parser_t *parser)
 		break;
 	case TOK_FILE:
 		// Consume TOK_FILE
-		root = new_unary(next_token, NULL);
+		root = expr_kind(new_unary(parser, next_token, NULL),
+		                 NODE_FILE_TYPE);
 		parser_token_expect(parser, TOK_FILE);
 
 		// Must follow an OF
@@ -86,7 +93,8 @@ parser_type(parser_t *parser)
 		break;
 	case TOK_SET:
 		// Consume TOK_SET
-		root = new_unary(next_token, NULL);
+		root = expr_kind(new_unary(parser, next_token, NULL),
+		                 NODE_SET_TYPE);
 		parser_token_expect(parser, TOK_SET);
 
 		// Must follow an OF
@@ -97,7 +105,8 @@ parser_type(parser_t *parser)
 		break;
 	case TOK_RECORD:
 		// Consume RECORD
-		root = new_unary(next_token, NULL);
+		root = expr_kind(new_unary(parser, next_token, NULL),
+		                 NODE_RECORD_TYPE);
 		parser_token_expect(parser, TOK_RECORD);
 
 		root->exp_left = parser_field_list(parser);
@@ -106,7 +115,7 @@ parser_type(parser_t *parser)
 		parser_token_expect(parser, TOK_END);
 		break;
 	default:
-		if (packed) {
+		if (packed.type == TOK_PACKED) {
 			parser_error(parser,
 			             next_token,
 			             "Cannot use PACKED in this context");
@@ -116,8 +125,9 @@ parser_type(parser_t *parser)
 	}
 
 	// Wrap in a PACKED if we previously saw the packed keyword.
-	if (packed) {
-		root = new_unary(packed, root);
+	if (packed.type == TOK_PACKED) {
+		root = expr_kind(new_unary(parser, packed, root),
+		                 NODE_PACKED_TYPE);
 	}
 
 	return root;
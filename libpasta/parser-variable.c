@@ -25,33 +25,40 @@ static expr_t *expression_list(parser_t *parser);
 expr_t *
 parser_variable(parser_t *parser)
 {
-	token_t *ident = parser_token_expect(parser, TOK_IDENTIFIER);
+	token_t ident = parser_token_expect(parser, TOK_IDENTIFIER);
 	expr_t *nested;
 
 	/* Check if the identifier comes alone or not. */
 	if (has_extra(parser)) {
 		nested = extra(parser);
-		return new_unary(ident, nested);
+		return expr_kind(new_unary(parser, ident, nested),
+		                 NODE_VARIABLE);
 	} else {
-		return new_literal(ident);
+		return expr_kind(new_literal(parser, ident), NODE_IDENTIFIER);
 	}
 }
 
 static expr_t *
 extra(parser_t *parser)
 {
-	token_t *token;
+	token_t token;
 	expr_t *expr;
 
 	/* We are protected by has_extra, take the token. */
 	token = parser_token(parser);
-	expr = new_binary(token, NULL, NULL);
 
 	/* Some token types also have meta. */
-	if (token->type == TOK_DOT) {
+	if (token.type == TOK_DOT) {
+		expr = expr_kind(new_binary(parser, token, NULL, NULL),
+		                 NODE_FIELD_ACCESS);
 		expr->exp_left = parser_identifier(parser);
-	} else if (token->type == TOK_LBRACKET) {
+	} else if (token.type == TOK_LBRACKET) {
+		expr = expr_kind(new_binary(parser, token, NULL, NULL),
+		                 NODE_INDEX);
 		expr->exp_left = expression_list(parser);
+	} else {
+		expr = expr_kind(new_binary(parser, token, NULL, NULL),
+		                 NODE_DEREF);
 	}
 
 	/* Still more parts. */
@@ -65,39 +72,45 @@ extra(parser_t *parser)
 static int
 has_extra(parser_t *parser)
 {
-	token_t *tok = parser_peek(parser);
-	return tok->type == TOK_CARET || tok->type == TOK_DOT
-	       || tok->type == TOK_LBRACKET;
+	token_t tok = parser_peek(parser);
+	return tok.type == TOK_CARET || tok.type == TOK_DOT
+	       || tok.type == TOK_LBRACKET;
 }
 
 static expr_t *
 expression_list(parser_t *parser)
 {
 	expr_t *root = NULL, *next, *expr;
-	token_t *token;
+	token_t token;
 
 	for (;;) {
 		expr = parser_expression(parser);
 		token = parser_peek(parser);
 
-		if (token->type == TOK_RBRACKET) {
+		if (token.type == TOK_RBRACKET) {
 			token = parser_token(parser);
 
 			/* No more arguments after the one we currently have. */
+			expr = expr_kind(new_unary(parser, token, expr),
+			                 NODE_INDEX_LIST);
 			if (root == NULL) {
-				root = new_unary(token, expr);
+				root = expr;
 			} else {
-				next->exp_right = new_unary(token, expr);
+				next->exp_right = expr;
 			}
 			return root;
-		} else if (token->type == TOK_COMMA) {
+		} else if (token.type == TOK_COMMA) {
 			token = parser_token(parser);
 
 			if (root == NULL) {
-				root = new_binary(token, expr, NULL);
+				root = expr_kind(
+				    new_binary(parser, token, expr, NULL),
+				    NODE_INDEX_LIST);
 				next = root;
 			} else {
-				next->exp_right = new_binary(token, expr, NULL);
+				next->exp_right = expr_kind(
+				    new_binary(parser, token, expr, NULL),
+				    NODE_INDEX_LIST);
 				next = next->exp_right;
 			}
 		} else {
@@ -15,76 +15,214 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 #include "parser.h"
+#include "tokfile.h"
+#include <limits.h>
 #include <stdlib.h>
+#include <string.h>
 
 static void
-print_token(token_t *tok)
+print_token(parser_t *parser, FILE *out, token_t *tok)
 {
-	if (tok == 0) {
+	const char *lexeme = scanner_lexeme(parser->scanner, tok);
+
+	if (tok->type == TOK_NONE) {
 		return;
 	}
-	if (tok->meta != 0) {
-		printf("%s(%s)\n", tokentype_string(tok->type), tok->meta);
+	if (tok->length != 0 && lexeme != NULL) {
+		fprintf(out,
+		        "%s(%.*s)\n",
+		        tokentype_string(tok->type),
+		        (int) tok->length,
+		        lexeme);
 	} else {
-		puts(tokentype_string(tok->type));
+		fprintf(out, "%s\n", tokentype_string(tok->type));
 	}
 }
 
-static void
-dump_expr_impl(expr_t *expr, int indent)
-{
-	int i;
+static const char *node_kinds[] = {
+    [NODE_NONE] = "NONE",
+    [NODE_PROGRAM] = "PROGRAM",
+    [NODE_BLOCK] = "BLOCK",
+    [NODE_CONST_BLOCK] = "CONST_BLOCK",
+    [NODE_CONST_DECL] = "CONST_DECL",
+    [NODE_TYPE_BLOCK] = "TYPE_BLOCK",
+    [NODE_TYPE_DECL] = "TYPE_DECL",
+    [NODE_VAR_BLOCK] = "VAR_BLOCK",
+    [NODE_VAR_DECL] = "VAR_DECL",
+    [NODE_PROCEDURE] = "PROCEDURE",
+    [NODE_FUNCTION] = "FUNCTION",
+    [NODE_PROTOTYPE] = "PROTOTYPE",
+    [NODE_PARAMETERS] = "PARAMETERS",
+    [NODE_PARAMETER_GROUP] = "PARAMETER_GROUP",
+    [NODE_IDENTIFIER_LIST] = "IDENTIFIER_LIST",
+    [NODE_TYPE_NAME] = "TYPE_NAME",
+    [NODE_ENUM_TYPE] = "ENUM_TYPE",
+    [NODE_SUBRANGE_TYPE] = "SUBRANGE_TYPE",
+    [NODE_SIZED_TYPE] = "SIZED_TYPE",
+    [NODE_POINTER_TYPE] = "POINTER_TYPE",
+    [NODE_ARRAY_TYPE] = "ARRAY_TYPE",
+    [NODE_INDEX_TYPES] = "INDEX_TYPES",
+    [NODE_FILE_TYPE] = "FILE_TYPE",
+    [NODE_SET_TYPE] = "SET_TYPE",
+    [NODE_RECORD_TYPE] = "RECORD_TYPE",
+    [NODE_PACKED_TYPE] = "PACKED_TYPE",
+    [NODE_FIELD_LIST] = "FIELD_LIST",
+    [NODE_FIELD] = "FIELD",
+    [NODE_VARIANT] = "VARIANT",
+    [NODE_VARIANT_BRANCH] = "VARIANT_BRANCH",
+    [NODE_COMPOUND] = "COMPOUND",
+    [NODE_ASSIGN] = "ASSIGN",
+    [NODE_CALL] = "CALL",
+    [NODE_ARGUMENTS] = "ARGUMENTS",
+    [NODE_IF] = "IF",
+    [NODE_THEN] = "THEN",
+    [NODE_ELSE] = "ELSE",
+    [NODE_REPEAT] = "REPEAT",
+    [NODE_STATEMENTS] = "STATEMENTS",
+    [NODE_UNTIL] = "UNTIL",
+    [NODE_WHILE] = "WHILE",
+    [NODE_FOR] = "FOR",
+    [NODE_FOR_CONTROL] = "FOR_CONTROL",
+    [NODE_FOR_RANGE] = "FOR_RANGE",
+    [NODE_CASE] = "CASE",
+    [NODE_CASE_LIST] = "CASE_LIST",
+    [NODE_CASE_ITEM] = "CASE_ITEM",
+    [NODE_CASE_LABELS] = "CASE_LABELS",
+    [NODE_WITH] = "WITH",
+    [NODE_WITH_VARIABLES] = "WITH_VARIABLES",
+    [NODE_GOTO] = "GOTO",
+    [NODE_EXIT] = "EXIT",
+    [NODE_IDENTIFIER] = "IDENTIFIER",
+    [NODE_NUMBER] = "NUMBER",
+    [NODE_STRING] = "STRING",
+    [NODE_NIL] = "NIL",
+    [NODE_UNARY_OP] = "UNARY_OP",
+    [NODE_BINARY_OP] = "BINARY_OP",
+    [NODE_GROUPING] = "GROUPING",
+    [NODE_SET] = "SET",
+    [NODE_RANGE] = "RANGE",
+    [NODE_VARIABLE] = "VARIABLE",
+    [NODE_FIELD_ACCESS] = "FIELD_ACCESS",
+    [NODE_INDEX] = "INDEX",
+    [NODE_INDEX_LIST] = "INDEX_LIST",
+    [NODE_DEREF] = "DEREF",
+};
 
-	if (!expr) {
-		return;
-	}
-
-	for (i = 0; i < indent; i++) {
-		printf("|");
-		if (i == indent - 1) {
-			printf("- ");
-		} else {
-			printf("  ");
-		}
+const char *
+node_kind_string(node_kind_t kind)
+{
+	if ((unsigned int) kind >= sizeof(node_kinds) / sizeof(*node_kinds)) {
+		return "<null>";
 	}
+	return node_kinds[kind];
+}
 
+static void
+print_type(parser_t *parser, FILE *out, expr_t *expr)
+{
 	switch (expr->type) {
 	case BINARY:
-		printf("BINARY ");
+		fputs("BINARY ", out);
 		break;
 	case UNARY:
-		printf("UNARY ");
+		fputs("UNARY ", out);
 		break;
 	case GROUPING:
-		printf("GROUPING ");
+		fputs("GROUPING ", out);
 		break;
 	case LITERAL:
-		printf("LITERAL ");
+		fputs("LITERAL ", out);
 		break;
+	case LIST:
+		/* unlike groupings, which go on with their child. */
+		fputs(expr->token.type == TOK_NONE ? "LIST\n" : "LIST ", out);
+		break;
+	}
+	print_token(parser, out, &expr->token);
+}
+
+static void
+print_kind(parser_t *parser, FILE *out, expr_t *expr)
+{
+	if (expr->token.type == TOK_NONE) {
+		fprintf(out, "%s\n", node_kind_string(expr->kind));
+	} else {
+		fprintf(out, "%s ", node_kind_string(expr->kind));
+		print_token(parser, out, &expr->token);
+	}
+}
+
+static void
+dump_expr_impl(parser_t *parser,
+               FILE *out,
+               expr_t *expr,
+               int indent,
+               int kinds)
+{
+	unsigned int item;
+	int i;
+
+	if (!expr) {
+		return;
+	}
+
+	for (i = 0; i < indent; i++) {
+		fputs(i == indent - 1 ? "|- " : "|  ", out);
+	}
+
+	if (kinds) {
+		print_kind(parser, out, expr);
+	} else {
+		print_type(parser, out, expr);
+	}
+	dump_expr_impl(parser, out, expr->exp_left, indent + 1, kinds);
+	dump_expr_impl(parser, out, expr->exp_right, indent + 1, kinds);
+	for (item = 0; item < expr->count; item++) {
+		dump_expr_impl(parser,
+		               out,
+		               expr->items[item],
+		               indent + 1,
+		               kinds);
 	}
-	print_token(expr->token);
-	dump_expr_impl(expr->exp_left, indent + 1);
-	dump_expr_impl(expr->exp_right, indent + 1);
 }
 
 /* TODO: This function should be moved to repl.c, but it is useful for
  * debugging. */
 void
-dump_expr(expr_t *expr)
+dump_expr(parser_t *parser, FILE *out, expr_t *expr)
 {
-	dump_expr_impl(expr, 0);
+	dump_expr_impl(parser, out, expr, 0, 0);
 }
 
 void
-expr_free(expr_t *expr)
+dump_expr_kinds(parser_t *parser, FILE *out, expr_t *expr)
+{
+	dump_expr_impl(parser, out, expr, 0, 1);
+}
+
+/* Zeroed node from the arena of the parser. Running out of memory is
+ * reported like a syntax error, since it cannot parse any further. */
+static expr_t *
+new_node(parser_t *parser)
 {
-	free(expr);
+	expr_t *exp = NULL;
+
+	if (parser->arena == NULL) {
+		parser->arena = arena_new();
+	}
+	if (parser->arena) {
+		exp = arena_alloc(parser->arena, sizeof(expr_t));
+	}
+	if (exp == NULL) {
+		parser_error(parser, parser_peek(parser), "Out of memory");
+	}
+	return exp;
 }
 
 expr_t *
-new_unary(token_t *t, expr_t *expr)
+new_unary(parser_t *parser, token_t t, expr_t *expr)
 {
-	expr_t *exp = (expr_t *) calloc(sizeof(expr_t), 1);
+	expr_t *exp = new_node(parser);
 	exp->type = UNARY;
 	exp->exp_left = expr;
 	exp->token = t;
@@ -92,9 +230,9 @@ new_unary(token_t *t, expr_t *expr)
 }
 
 expr_t *
-new_binary(token_t *t, expr_t *left, expr_t *right)
+new_binary(parser_t *parser, token_t t, expr_t *left, expr_t *right)
 {
-	expr_t *exp = (expr_t *) calloc(sizeof(expr_t), 1);
+	expr_t *exp = new_node(parser);
 	exp->type = BINARY;
 	exp->exp_left = left;
 	exp->exp_right = right;
@@ -103,110 +241,372 @@ new_binary(token_t *t, expr_t *left, expr_t *right)
 }
 
 expr_t *
-new_grouping(expr_t *wrap)
+new_grouping(parser_t *parser, expr_t *wrap)
 {
-	expr_t *exp = (expr_t *) calloc(sizeof(expr_t), 1);
+	expr_t *exp = new_node(parser);
 	exp->type = GROUPING;
 	exp->exp_left = wrap;
+	exp->token = token_none;
 	return exp;
 }
 
 expr_t *
-new_literal(token_t *tok)
+new_literal(parser_t *parser, token_t tok)
 {
-	expr_t *exp = (expr_t *) calloc(sizeof(expr_t), 1);
+	expr_t *exp = new_node(parser);
 	exp->type = LITERAL;
 	exp->token = tok;
 	return exp;
 }
 
+expr_t *
+expr_kind(expr_t *expr, node_kind_t kind)
+{
+	expr->kind = kind;
+	return expr;
+}
+
+unsigned int
+parser_list_start(parser_t *parser)
+{
+	return parser->list_len;
+}
+
+void
+parser_list_push(parser_t *parser, expr_t *item)
+{
+	expr_t **items;
+	unsigned int cap;
+
+	if (parser->list_len == parser->list_cap) {
+		cap = parser->list_cap ? parser->list_cap * 2 : 64;
+		items = realloc(parser->list_items, sizeof(expr_t *) * cap);
+		if (items == NULL) {
+			parser_error(parser,
+			             parser_peek(parser),
+			             "Out of memory");
+		}
+		parser->list_items = items;
+		parser->list_cap = cap;
+	}
+	parser->list_items[parser->list_len++] = item;
+}
+
+expr_t *
+new_list(parser_t *parser, token_t t, unsigned int start)
+{
+	expr_t *exp = new_node(parser);
+	unsigned int count = parser->list_len - start;
+
+	exp->type = LIST;
+	exp->token = t;
+	exp->count = count;
+	if (count > 0) {
+		exp->items =
+		    arena_alloc(parser->arena, sizeof(expr_t *) * count);
+		if (exp->items == NULL) {
+			parser_error(parser,
+			             parser_peek(parser),
+			             "Out of memory");
+		}
+		memcpy(exp->items,
+		       parser->list_items + start,
+		       sizeof(expr_t *) * count);
+	}
+	parser->list_len = start;
+	return exp;
+}
+
 ////
 
 parser_t *
 parser_new()
 {
 	parser_t *par = (parser_t *) malloc(sizeof(parser_t));
-	par->tokens = NULL;
-	par->len = 0;
+	tokstream_init(&par->tokens);
 	par->pos = 0;
+	par->scanner = NULL;
+	par->streaming = 0;
+	par->ring_len = 0;
+	par->ring_eof = 0;
+	par->mapped = NULL;
+	par->mapped_len = 0;
+	par->arena = NULL;
+	par->list_items = NULL;
+	par->list_len = 0;
+	par->list_cap = 0;
+	par->stmt_frames = NULL;
+	par->stmt_len = 0;
+	par->stmt_cap = 0;
+	par->max_depth = PARSER_MAX_DEPTH;
+	par->pending = NULL;
+	par->pending_len = 0;
+	par->pending_cap = 0;
+	par->expr_depth = 0;
+	par->diagnostics = NULL;
+	par->diagnostics_len = 0;
+	par->diagnostics_cap = 0;
+	par->recover = NULL;
+	par->recover_pos = UINT_MAX;
 	return par;
 }
 
-#define TOKEN_LOAD_BUFSIZ 64
+void
+parser_free(parser_t *parser)
+{
+	if (parser->mapped) {
+		tokfile_unmap(parser);
+	} else {
+		tokstream_free(&parser->tokens);
+	}
+	if (parser->arena) {
+		arena_free(parser->arena);
+	}
+	free(parser->list_items);
+	free(parser->stmt_frames);
+	free(parser->pending);
+	free(parser->diagnostics);
+	free(parser);
+}
 
-static int
-parser_append(parser_t *parser, token_t **tlist, int len)
+parse_result_t *
+parser_parse(parser_t *parser, expr_t *(*rule)(parser_t *))
 {
-	unsigned i;
-	token_t **next;
+	parse_result_t *result;
+	diagnostic_t *diagnostics = NULL;
+	size_t size;
+	jmp_buf env;
+	expr_t *root;
 
-	next = realloc(parser->tokens, sizeof(token_t *) * (parser->len + len));
-	if (next == NULL) {
-		return 0;
+	/* errors that no rule recovered from end up here, with no tree. */
+	parser->recover = &env;
+	if (setjmp(env)) {
+		parser->stmt_len = 0;
+		parser->list_len = 0;
+		root = NULL;
+	} else {
+		root = rule(parser);
+	}
+	parser->recover = NULL;
+	if (parser->streaming && scanner_failed(parser->scanner)) {
+		return NULL;
 	}
 
-	for (i = 0; i < len; i++) {
-		next[i + parser->len] = tlist[i];
+	/* the result lives in the arena too, so freeing it is one call. */
+	if (parser->arena == NULL && (parser->arena = arena_new()) == NULL) {
+		return NULL;
 	}
-	parser->tokens = next;
-	parser->len += len;
-	return 1;
+	if ((result = arena_alloc(parser->arena, sizeof(*result))) == NULL) {
+		return NULL;
+	}
+	size = sizeof(diagnostic_t) * parser->diagnostics_len;
+	if (size > 0) {
+		if ((diagnostics = arena_alloc(parser->arena, size)) == NULL) {
+			return NULL;
+		}
+		memcpy(diagnostics, parser->diagnostics, size);
+	}
+	result->root = root;
+	result->arena = parser->arena;
+	result->diagnostics = diagnostics;
+	result->diagnostics_len = parser->diagnostics_len;
+	parser->arena = NULL;
+	parser->diagnostics_len = 0;
+	return result;
 }
 
 void
+parse_result_free(parse_result_t *result)
+{
+	arena_free(result->arena);
+}
+
+/* Pascal sources average a token every four or five bytes, whitespace
+ * included, so this reservation usually fits every token of a file and
+ * the stream only has to grow for unusually dense code. */
+#define BYTES_PER_TOKEN 4
+
+int
 parser_load_tokens(parser_t *parser, scanner_t *scanner)
 {
-	int bufsiz = 0;
-	token_t *last_token = NULL;
-	token_t *tokens[TOKEN_LOAD_BUFSIZ];
-
-	do {
-		last_token = scanner_next(scanner);
-		tokens[bufsiz++] = last_token;
-
-		// If the buffer is full, concat to the parser.
-		if (bufsiz == TOKEN_LOAD_BUFSIZ) {
-			if (parser_append(parser, tokens, TOKEN_LOAD_BUFSIZ)
-			    == 0) {
-				printf("Algo ha salido mal"); // TODO: borrar
-				exit(1);
-			}
-			bufsiz = 0;
-		}
-	} while (last_token && last_token->type != TOK_EOF);
+	return parser_load_tokens_parallel(parser, scanner, 1);
+}
+
+int
+parser_load_tokens_parallel(parser_t *parser,
+                            scanner_t *scanner,
+                            unsigned int threads)
+{
+	/* tokens are slices of the scanner buffer, so keep it around. */
+	parser->scanner = scanner;
+
+	/* chunked input would be gone before the tokens are used. */
+	if (scanner_source(scanner) == NULL) {
+		return 0;
+	}
+	if (!tokstream_reserve(&parser->tokens,
+	                       scanner_length(scanner) / BYTES_PER_TOKEN + 1)) {
+		return 0;
+	}
+	return scanner_tokenize(scanner, &parser->tokens, threads);
+}
+
+void
+parser_stream_tokens(parser_t *parser, scanner_t *scanner)
+{
+	parser->scanner = scanner;
+	parser->streaming = 1;
+	parser->ring_len = 0;
+	parser->ring_eof = 0;
+}
+
+void
+parser_set_max_depth(parser_t *parser, unsigned int depth)
+{
+	parser->max_depth = depth;
+}
+
+/* Scans tokens into the ring until it holds count of them or the scanner
+ * is done. Returns the number of tokens available from pos onwards. */
+static unsigned int
+parser_fill(parser_t *parser, unsigned int count)
+{
+	token_t token;
 
-	// Add the remaining tokens that did not fill the buffer.
-	parser_append(parser, tokens, bufsiz);
+	while (parser->ring_len < count && !parser->ring_eof) {
+		token = scanner_next(parser->scanner);
+		parser->ring[(parser->pos + parser->ring_len)
+		             & (PARSER_LOOKAHEAD - 1)] = token;
+		parser->ring_len++;
+		parser->ring_eof = token.type == TOK_EOF;
+	}
+	return parser->ring_len;
+}
+
+/* Keeps an error for the result. One at the same token as the previous
+ * error is most likely caused by it, so it is left out. */
+static void
+parser_diagnose(parser_t *parser, token_t token, const char *message)
+{
+	diagnostic_t *diagnostic, *diagnostics;
+	unsigned int cap;
+
+	if (parser->diagnostics_len > 0) {
+		diagnostic = &parser->diagnostics[parser->diagnostics_len - 1];
+		if (diagnostic->token.offset == token.offset) {
+			return;
+		}
+	}
+	if (parser->diagnostics_len == parser->diagnostics_cap) {
+		cap = parser->diagnostics_cap ? parser->diagnostics_cap * 2 : 8;
+		diagnostics = realloc(parser->diagnostics,
+		                      sizeof(diagnostic_t) * cap);
+		if (diagnostics == NULL) {
+			return;
+		}
+		parser->diagnostics = diagnostics;
+		parser->diagnostics_cap = cap;
+	}
+	diagnostic = &parser->diagnostics[parser->diagnostics_len++];
+	diagnostic->token = token;
+	diagnostic->line = 0;
+	diagnostic->col = 0;
+	diagnostic->message = message;
+	scanner_position(parser->scanner,
+	                 token.offset,
+	                 &diagnostic->line,
+	                 &diagnostic->col);
 }
 
 void __attribute__((noreturn))
-parser_error(parser_t *parser, token_t *token, char *error)
+parser_error(parser_t *parser, token_t token, char *error)
 {
-	printf("Error: %s. ", error);
-	print_token(token);
-	printf("\n");
-	printf(" Line: %d, Col: %d\n", token->line, token->col);
-	exit(1);
+	/* rules can only be run by parser_parse. */
+	if (parser->recover == NULL) {
+		abort();
+	}
+	parser_diagnose(parser, token, error);
+
+	/* no rule recovers in the middle of an expression, so whatever was
+	 * pending in the ones being parsed is gone. */
+	parser->pending_len = 0;
+	parser->expr_depth = 0;
+	longjmp(*parser->recover, 1);
 }
 
-token_t *
+void
+parser_skip_to(parser_t *parser, int (*stop)(tokentype_t))
+{
+	token_t token;
+
+	if (parser->pos == parser->recover_pos) {
+		parser_token(parser);
+	}
+	for (;;) {
+		token = parser_peek(parser);
+		if (token.type == TOK_EOF || stop(token.type)) {
+			break;
+		}
+		parser_token(parser);
+	}
+	parser->recover_pos = parser->pos;
+}
+
+/* Token at pos + offset, if there is one. In streaming mode the offset
+ * must be below PARSER_LOOKAHEAD. */
+static int
+parser_lookahead(parser_t *parser, unsigned int offset, token_t *token)
+{
+	if (!parser->streaming) {
+		if (parser->pos + offset >= parser->tokens.len) {
+			return 0;
+		}
+		*token = tokstream_get(&parser->tokens, parser->pos + offset);
+		return 1;
+	}
+	if (offset >= PARSER_LOOKAHEAD
+	    || parser_fill(parser, offset + 1) <= offset) {
+		return 0;
+	}
+	*token = parser->ring[(parser->pos + offset) & (PARSER_LOOKAHEAD - 1)];
+	return 1;
+}
+
+token_t
 parser_peek(parser_t *parser)
 {
-	return parser->tokens[parser->pos];
+	token_t token = token_none;
+
+	/* there is always at least the TOK_EOF token. */
+	parser_lookahead(parser, 0, &token);
+	return token;
 }
 
-token_t *
+token_t
 parser_peek_far(parser_t *parser, unsigned int offset)
 {
-	if (parser->pos + offset < parser->len) {
-		return parser->tokens[parser->pos + offset];
+	token_t token;
+
+	if (parser_lookahead(parser, offset, &token)) {
+		return token;
 	}
 	// TODO: devolver EOF
-	parser_error(parser, parser->tokens[parser->pos], "EOF");
+	parser_error(parser, parser_peek(parser), "EOF");
 }
 
-token_t *
+/* The last token is always TOK_EOF, which is never consumed, so that
+ * reading past the end keeps returning it instead of overflowing. */
+token_t
 parser_token(parser_t *parser)
 {
-	return parser->tokens[parser->pos++];
+	token_t token = parser_peek(parser);
+
+	if (token.type == TOK_EOF) {
+		return token;
+	}
+	parser->pos++;
+	if (parser->streaming) {
+		parser->ring_len--;
+	}
+	return token;
 }
@@ -14,66 +14,180 @@
  * You should have received a copy of the GNU General Public License
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
+#include "memscan.h"
+#include "number.h"
 #include "scanner.h"
 #include "token.h"
 
-#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
+/*
+ * Character classes. Every byte of the input is classified with a single
+ * lookup into charclass, which does not depend on the process locale like
+ * the functions in ctype.h do. Bytes outside ASCII have no class at all.
+ */
+#define CHAR_SPACE 0x01 /* whitespace skipped between tokens */
+#define CHAR_ALPHA 0x02 /* letters and underscore, may start identifiers */
+#define CHAR_DIGIT 0x04 /* decimal digits */
+#define CHAR_QUOTE 0x08 /* starts a string: a quote or a control code */
+#define CHAR_SYMBOL 0x10 /* starts a symbol token, see symbols below */
+
+#define CHAR_IDENT (CHAR_ALPHA | CHAR_DIGIT)
+
+static const unsigned char charclass[256] = {
+    ['\t'] = CHAR_SPACE,
+    ['\n'] = CHAR_SPACE,
+    ['\r'] = CHAR_SPACE,
+    [' '] = CHAR_SPACE,
+    ['#'] = CHAR_QUOTE,
+    ['$'] = CHAR_SYMBOL,
+    ['\''] = CHAR_QUOTE,
+    ['('] = CHAR_SYMBOL,
+    [')'] = CHAR_SYMBOL,
+    ['*'] = CHAR_SYMBOL,
+    ['+'] = CHAR_SYMBOL,
+    [','] = CHAR_SYMBOL,
+    ['-'] = CHAR_SYMBOL,
+    ['.'] = CHAR_SYMBOL,
+    ['/'] = CHAR_SYMBOL,
+    ['0' ... '9'] = CHAR_DIGIT,
+    [':'] = CHAR_SYMBOL,
+    [';'] = CHAR_SYMBOL,
+    ['<'] = CHAR_SYMBOL,
+    ['='] = CHAR_SYMBOL,
+    ['>'] = CHAR_SYMBOL,
+    ['@'] = CHAR_SYMBOL,
+    ['A' ... 'Z'] = CHAR_ALPHA,
+    ['['] = CHAR_SYMBOL,
+    [']'] = CHAR_SYMBOL,
+    ['^'] = CHAR_SYMBOL,
+    ['_'] = CHAR_ALPHA,
+    ['a' ... 'z'] = CHAR_ALPHA,
+};
+
+#define CHARCLASS(ch) (charclass[(unsigned char) (ch)])
+
+/*
+ * Transition table for symbols. A symbol is a single character token, but
+ * some of them become a different token when followed by a specific second
+ * character, such as : and :=. There are at most two of those transitions
+ * per symbol, so the DFA for symbols is at most two states deep.
+ */
+struct symbol {
+	tokentype_t single;
+	struct {
+		char follow;
+		tokentype_t type;
+	} pair[2];
+};
+
+static const struct symbol symbols[128] = {
+    ['$'] = {TOK_DOLLAR},
+    ['('] = {TOK_LPAREN},
+    [')'] = {TOK_RPAREN},
+    ['*'] = {TOK_ASTERISK},
+    ['+'] = {TOK_PLUS},
+    [','] = {TOK_COMMA},
+    ['-'] = {TOK_MINUS},
+    ['.'] = {TOK_DOT, {{'.', TOK_DOTDOT}}},
+    ['/'] = {TOK_SLASH},
+    [':'] = {TOK_COLON, {{'=', TOK_ASSIGN}}},
+    [';'] = {TOK_SEMICOLON},
+    ['<'] = {TOK_LESSER, {{'=', TOK_LESSEQL}, {'>', TOK_NEQUAL}}},
+    ['='] = {TOK_EQUAL},
+    ['>'] = {TOK_GREATER, {{'=', TOK_GREATEQL}}},
+    ['@'] = {TOK_AT},
+    ['['] = {TOK_LBRACKET},
+    [']'] = {TOK_RBRACKET},
+    ['^'] = {TOK_CARET},
+};
+
+/*
+ * The scanner buffer is always sentinel-padded: the input is followed by
+ * SCANNER_PADDING NUL bytes. A NUL byte is the end of the input, and no
+ * character class accepts it, so every loop in the scanner stops on it
+ * without comparing the position against the length, and lookahead of a
+ * few characters past the end still reads valid memory.
+ *
+ * Lines are not tracked while scanning. The first time a position is
+ * requested, the offset where every line starts is stored in lines, and
+ * positions are found with a binary search on it.
+ *
+ * With chunked input, buffer is a window that starts at offset base of the
+ * input. When a token ends too close to the end of the window, it might
+ * have been cut, so the bytes before it are dropped, more input is read
+ * after it, and it is scanned again. Lines are counted as bytes are
+ * dropped, since an index of the whole input cannot be kept.
+ */
 struct scanner {
 	char *buffer;
 	unsigned int len;
 	unsigned int pos;
-	unsigned int line, col;
+	const struct memscan *scan;
+	int owned; /* buffer was allocated by the scanner */
+	size_t mapped; /* bytes mapped by scanner_init_mapped, or 0 */
+	unsigned int *lines;
+	unsigned int nlines;
+	symtab_t *symtab; /* interns identifiers, unless NULL */
+	strarena_t *strarena; /* decodes strings, unless NULL */
+	number_t *numbers; /* value of TOK_DIGIT tokens, by token value - 1 */
+	unsigned int nnumbers, numbers_cap;
+	int numbers_borrowed; /* see scanner_use_numbers */
+
+	scanner_read_t read;
+	void *ctx;
+	int eof;          /* there is no more input to read */
+	int failed;       /* ran out of memory, so eof is not the end */
+	size_t chunk;     /* bytes asked to the reader every time */
+	size_t size;      /* bytes allocated for buffer, minus the padding */
+	unsigned int base;       /* offset of buffer[0] in the input */
+	unsigned int line_base;  /* lines that end before buffer[0] */
+	unsigned int line_start; /* offset of the line with buffer[0] */
 };
 
+/*
+ * How many characters past the end of a token the scanner may read while
+ * scanning it. If they are not all part of the window, the token has to
+ * be scanned again once there is more input.
+ */
+#define SCANNER_LOOKAHEAD 2
+
 /** returns the next character in the scanner without consuming it. */
-static int
+static char
 scanner_peek(scanner_t *scanner)
 {
-	if (scanner->pos >= scanner->len) {
-		return EOF;
-	}
 	return scanner->buffer[scanner->pos];
 }
 
-static int
+static char
 scanner_peekfar(scanner_t *scanner, int offt)
 {
-	size_t ea = scanner->pos + offt;
-	if (ea >= scanner->len) {
-		return EOF;
-	}
-	return scanner->buffer[ea];
+	return scanner->buffer[scanner->pos + offt];
 }
 
 static void
 scanner_advance(scanner_t *scanner)
 {
-	if (scanner->buffer[scanner->pos] == '\n') {
-		scanner->line++;
-		scanner->col = 0;
-	}
 	scanner->pos++;
-	scanner->col++;
-}
-
-static void
-scanner_consume_until_char(scanner_t *scanner, char ch)
-{
-	while (scanner->buffer[scanner->pos] != ch)
-		scanner_advance(scanner);
 }
 
 static void
 consume_until_closing_bracket(scanner_t *scanner)
 {
 	// read until we find a closing bracket
-	while (scanner->buffer[scanner->pos] != '}')
-		scanner_advance(scanner);
-	scanner_advance(scanner); // skip the bracket itself
+	scanner->pos = scanner->scan->find(scanner->buffer, scanner->pos, '}');
+	if (scanner_peek(scanner) == '}') {
+		scanner_advance(scanner); // skip the bracket itself
+	}
 }
 
 static void
@@ -81,29 +195,27 @@ consume_until_closing_trigraph(scanner_t *scanner)
 {
 	// read until we find a *)
 	for (;;) {
-		while (scanner->buffer[scanner->pos] != '*')
-			scanner_advance(scanner);
-		if (scanner->buffer[scanner->pos + 1] == ')') {
+		scanner->pos =
+		    scanner->scan->find(scanner->buffer, scanner->pos, '*');
+		if (scanner_peek(scanner) == 0) {
+			return;
+		}
+		if (scanner_peekfar(scanner, 1) == ')') {
 			// a real trigraph ending.
 			scanner->pos += 2;
-			scanner->col += 2;
 			return;
-		} else {
-			// not a real trigraph ending, just an alone asterisk
-			// skip it and continue reading characters
-			scanner_advance(scanner);
 		}
+		// not a real trigraph ending, just an alone asterisk
+		// skip it and continue reading characters
+		scanner_advance(scanner);
 	}
 }
 
 static void
 consume_slash_comment(scanner_t *scanner)
 {
-	// read until the end of the line
-	while (scanner->buffer[scanner->pos] != '\n')
-		scanner_advance(scanner);
-	while (scanner->buffer[scanner->pos] == '\n')
-		scanner_advance(scanner);
+	// read until the end of the line, the newline is whitespace
+	scanner->pos = scanner->scan->find(scanner->buffer, scanner->pos, '\n');
 }
 
 // check that the scanner points at a valid character, and moves the
@@ -112,39 +224,30 @@ consume_slash_comment(scanner_t *scanner)
 static void
 scanner_clean(scanner_t *scanner)
 {
-	char ch;
-	int valid;
+	for (;;) {
+		scanner->pos =
+		    scanner->scan->skip_spaces(scanner->buffer, scanner->pos);
 
-	do {
-		valid = 1;
-
-		ch = scanner->buffer[scanner->pos];
-		switch (ch) {
-		case '\n':
-		case '\r':
-		case '\t':
-		case ' ':
-			scanner_advance(scanner);
-			valid = 0;
-			break;
+		switch (scanner_peek(scanner)) {
 		case '{':
 			consume_until_closing_bracket(scanner);
-			valid = 0;
 			break;
 		case '/':
-			if (scanner->buffer[scanner->pos + 1] == '/') {
-				consume_slash_comment(scanner);
-				valid = 0;
+			if (scanner_peekfar(scanner, 1) != '/') {
+				return;
 			}
+			consume_slash_comment(scanner);
 			break;
 		case '(':
-			if (scanner->buffer[scanner->pos + 1] == '*') {
-				consume_until_closing_trigraph(scanner);
-				valid = 0;
+			if (scanner_peekfar(scanner, 1) != '*') {
+				return;
 			}
+			consume_until_closing_trigraph(scanner);
 			break;
+		default:
+			return;
 		}
-	} while (!valid);
+	}
 }
 
 static void
@@ -154,32 +257,51 @@ scanner_discard(scanner_t *scanner)
 	scanner_clean(scanner);
 }
 
-static token_t *
-alloc_token_with_meta(scanner_t *scanner, tokentype_t type, char *value)
+static token_t
+make_token_with_meta(scanner_t *scanner, tokentype_t type, unsigned int len)
 {
-	token_t *tok;
-	if ((tok = malloc(sizeof(token_t))) != NULL) {
-		tok->type = type;
-		tok->meta = value;
-		tok->line = scanner->line;
-		tok->col = scanner->col;
-	}
+	token_t tok;
+	tok.type = type;
+	tok.offset = scanner->base + scanner->pos;
+	tok.length = len;
+	tok.value = 0;
 	return tok;
 }
 
-static token_t *
-alloc_token(scanner_t *scanner, tokentype_t type)
+static token_t
+make_token(scanner_t *scanner, tokentype_t type)
 {
-	return alloc_token_with_meta(scanner, type, 0);
+	return make_token_with_meta(scanner, type, 0);
 }
 
-static token_t *
+static token_t
+scanner_read_as_symbol(scanner_t *scanner, char next)
+{
+	const struct symbol *symbol = &symbols[(unsigned char) next];
+	char follow = scanner_peekfar(scanner, 1);
+	token_t token;
+	int i;
+
+	for (i = 0; i < 2 && symbol->pair[i].follow; i++) {
+		if (symbol->pair[i].follow == follow) {
+			token = make_token(scanner, symbol->pair[i].type);
+			scanner_discard(scanner);
+			scanner_discard(scanner);
+			return token;
+		}
+	}
+
+	token = make_token(scanner, symbol->single);
+	scanner_discard(scanner);
+	return token;
+}
+
+static token_t
 scanner_read_as_number(scanner_t *scanner)
 {
 	int len = 0, flag = 0;
 	char chr;
-	char *value;
-	token_t *token;
+	token_t token;
 
 	for (;;) {
 		chr = scanner_peekfar(scanner, len);
@@ -239,95 +361,91 @@ scanner_read_as_number(scanner_t *scanner)
 		break;
 	}
 
-	/* extract the string from the buffer */
-	value = malloc(sizeof(char) * len + 1);
-	memcpy(value, scanner->buffer + scanner->pos, len);
-	value[len] = 0;
-
 	/* consume the characters once read */
-	token = alloc_token_with_meta(scanner, TOK_DIGIT, value);
+	token = make_token_with_meta(scanner, TOK_DIGIT, len);
 	scanner->pos += len;
-	scanner->col += len;
 	return token;
 }
 
-static token_t *
+static token_t
 scanner_read_as_identifier(scanner_t *scanner)
 {
 	int len = 0;
 	char chr;
-	char *value;
 	tokentype_t type;
-	token_t *token;
+	token_t token;
 
 	for (;;) {
 		chr = scanner_peekfar(scanner, len);
-		if (!isalpha(chr) && !isdigit(chr) && chr != '_')
+		if (!(CHARCLASS(chr) & CHAR_IDENT))
 			break;
 		len++;
 	}
 
-	/* extract the string from the buffer */
-	value = malloc(sizeof(char) * len + 1);
-	memcpy(value, scanner->buffer + scanner->pos, len);
-	value[len] = 0;
-
 	/* check out the lookup table in case it is a keyword. */
-	type = match_identifier(value);
+	type = match_identifier(scanner->buffer + scanner->pos, len);
 	if (type == TOK_IDENTIFIER) {
-		token = alloc_token_with_meta(scanner, type, value);
+		token = make_token_with_meta(scanner, type, len);
 	} else {
-		token = alloc_token(scanner, type);
+		token = make_token(scanner, type);
 	}
 
 	/* consume the characters */
 	scanner->pos += len;
-	scanner->col += len;
 
 	return token;
 }
 
-static token_t *
+static token_t
 scanner_read_as_string(scanner_t *scanner)
 {
-	char *meta;
 	char chr;
 	int len = 0;
-	token_t *tok;
+	token_t tok;
 
 	for (;;) {
 		chr = scanner_peekfar(scanner, len);
 		switch (chr) {
 		case '\'':
-			len++;
-			while (scanner_peekfar(scanner, len) != '\'') {
-				// continue reading until the end of the
-				// string
-				len++;
+			// continue reading until the end of the string, or
+			// the end of the input if the string is not terminated
+			len = scanner->scan->find(scanner->buffer,
+			                          scanner->pos + len + 1,
+			                          '\'')
+			      - scanner->pos;
+			chr = scanner_peekfar(scanner, len);
+			if (chr == '\'') {
+				len++; // skip the closing quote or this will
+				       // be an infinite loop
 			}
-			len++; // skip the closing quote or this will be
-			       // an infinite loop
 			break;
 		case '#':
 			len++;
-			while (isdigit(scanner_peekfar(scanner, len)))
+			while (CHARCLASS(scanner_peekfar(scanner, len))
+			       & CHAR_DIGIT)
 				len++;
 			break;
 		default:
 			// the string is over
-			meta = malloc(sizeof(char) * len + 1);
-			memcpy(meta, scanner->buffer + scanner->pos, len);
-			meta[len] = 0;
-			tok = alloc_token_with_meta(scanner, TOK_STRING, meta);
+			tok = make_token_with_meta(scanner, TOK_STRING, len);
 			scanner->pos += len;
-			scanner->col += len;
 			return tok;
 		}
 	}
 }
 
-scanner_t *
-scanner_init(char *buffer, size_t len)
+static void
+scanner_skip_bom(scanner_t *scanner)
+{
+	if (scanner->buffer[0] == (char) 0xEF
+	    && scanner->buffer[1] == (char) 0xBB
+	    && scanner->buffer[2] == (char) 0xBF) {
+		scanner->pos = 4;
+	}
+}
+
+static scanner_t *
+scanner_setup(char *buffer, size_t len, int owned)
 {
 	scanner_t *scanner = malloc(sizeof(scanner_t));
 
@@ -335,153 +453,786 @@ scanner_init(char *buffer, size_t len)
 		scanner->buffer = buffer;
 		scanner->len = len;
 		scanner->pos = 0;
-		scanner->line = 1;
-		scanner->col = 1;
-
-		// skip the BOM mark
-		if (scanner->buffer[0] == (char) 0xEF
-		    && scanner->buffer[1] == (char) 0xBB
-		    && scanner->buffer[2] == (char) 0xBF) {
-			scanner->pos = 4;
+		scanner->scan = memscan_select();
+		scanner->owned = owned;
+		scanner->mapped = 0;
+		scanner->lines = NULL;
+		scanner->nlines = 0;
+		scanner->symtab = NULL;
+		scanner->strarena = NULL;
+		scanner->numbers = NULL;
+		scanner->nnumbers = 0;
+		scanner->numbers_cap = 0;
+		scanner->numbers_borrowed = 0;
+		scanner->read = NULL;
+		scanner->ctx = NULL;
+		scanner->eof = 1;
+		scanner->failed = 0;
+		scanner->chunk = 0;
+		scanner->size = len;
+		scanner->base = 0;
+		scanner->line_base = 0;
+		scanner->line_start = 0;
+		scanner_skip_bom(scanner);
+	}
+
+	return scanner;
+}
+
+scanner_t *
+scanner_init(char *buffer, size_t len)
+{
+	scanner_t *scanner;
+	char *padded;
+
+	if ((padded = malloc(len + SCANNER_PADDING)) == NULL) {
+		return NULL;
+	}
+	memcpy(padded, buffer, len);
+	memset(padded + len, 0, SCANNER_PADDING);
+
+	if ((scanner = scanner_setup(padded, len, 1)) == NULL) {
+		free(padded);
+	}
+	return scanner;
+}
+
+scanner_t *
+scanner_init_padded(char *buffer, size_t len)
+{
+	return scanner_setup(buffer, len, 0);
+}
+
+/*
+ * The padding comes for free for most files, since the kernel fills the
+ * rest of the last page of a mapping with zeros. The anonymous mapping
+ * under the file covers the case where that is less than the padding.
+ */
+scanner_t *
+scanner_init_mapped(int fd)
+{
+	struct stat st;
+	size_t len, size, page = sysconf(_SC_PAGESIZE);
+	scanner_t *scanner;
+	char *map;
+
+	if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode)
+	    || st.st_size > UINT_MAX) {
+		return NULL;
+	}
+	len = st.st_size;
+	size = (len + SCANNER_PADDING + page - 1) / page * page;
+
+	map = mmap(NULL, size, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (map == MAP_FAILED) {
+		return NULL;
+	}
+	if (len > 0) {
+		if (mmap(map, len, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0)
+		    == MAP_FAILED) {
+			munmap(map, size);
+			return NULL;
 		}
+		madvise(map, len, MADV_SEQUENTIAL);
 	}
 
+	if ((scanner = scanner_setup(map, len, 0)) == NULL) {
+		munmap(map, size);
+		return NULL;
+	}
+	scanner->mapped = size;
+	return scanner;
+}
+
+/* Counts the lines that end in the first count bytes of the window. */
+static void
+scanner_drop_lines(scanner_t *scanner, unsigned int count)
+{
+	const char *nl = scanner->buffer;
+	const char *end = scanner->buffer + count;
+
+	while ((nl = memchr(nl, '\n', end - nl)) != NULL) {
+		nl++;
+		scanner->line_base++;
+		scanner->line_start = scanner->base + (nl - scanner->buffer);
+	}
+}
+
+/*
+ * Drops the bytes of the window before keep and reads the next chunk of
+ * input after the rest, growing the buffer if there is no room left for
+ * it. Returns 0 at the end of the input or when out of memory.
+ *
+ * The token being scanned is kept and scanned again from its start, so
+ * at least as many bytes as were kept are read, even if the reader gives
+ * fewer at a time, as pipes do. A comment or string as long as the whole
+ * window then doubles it every time, instead of growing a chunk at a
+ * time, and scanning it again and again takes linear time overall.
+ */
+static int
+scanner_refill(scanner_t *scanner, unsigned int keep)
+{
+	unsigned int kept = scanner->len - keep;
+	size_t size, want, got, total = 0;
+	char *next;
+
+	scanner_drop_lines(scanner, keep);
+	memmove(scanner->buffer, scanner->buffer + keep, kept);
+	scanner->base += keep;
+	scanner->pos -= keep;
+	scanner->len = kept;
+
+	want = kept > scanner->chunk ? kept : scanner->chunk;
+	if (scanner->size - kept < want) {
+		size = scanner->size * 2;
+		if (size < kept + want) {
+			size = kept + want;
+		}
+		next = realloc(scanner->buffer, size + SCANNER_PADDING);
+		if (next == NULL) {
+			memset(scanner->buffer + kept, 0, SCANNER_PADDING);
+			scanner->failed = 1;
+			return 0;
+		}
+		scanner->buffer = next;
+		scanner->size = size;
+	}
+
+	do {
+		got = scanner->read(scanner->ctx,
+		                    scanner->buffer + kept + total,
+		                    scanner->size - kept - total);
+		total += got;
+	} while (got != 0 && total < kept);
+	scanner->len += total;
+	memset(scanner->buffer + scanner->len, 0, SCANNER_PADDING);
+	return total != 0;
+}
+
+scanner_t *
+scanner_init_reader(scanner_read_t read, void *ctx, size_t chunk)
+{
+	scanner_t *scanner;
+	char *buffer;
+
+	if (chunk == 0) {
+		chunk = SCANNER_CHUNK;
+	}
+	if ((buffer = malloc(chunk + SCANNER_PADDING)) == NULL) {
+		return NULL;
+	}
+	memset(buffer, 0, SCANNER_PADDING);
+	if ((scanner = scanner_setup(buffer, 0, 1)) == NULL) {
+		free(buffer);
+		return NULL;
+	}
+
+	scanner->read = read;
+	scanner->ctx = ctx;
+	scanner->chunk = chunk;
+	scanner->size = chunk;
+	do {
+		// make sure that a BOM is not split
+		scanner->eof = !scanner_refill(scanner, 0);
+	} while (!scanner->eof && scanner->len < 4);
+	scanner_skip_bom(scanner);
+	return scanner;
+}
+
+static size_t
+scanner_read_fd(void *ctx, char *buf, size_t len)
+{
+	int fd = (int) (intptr_t) ctx;
+	ssize_t got;
+
+	do {
+		got = read(fd, buf, len);
+	} while (got == -1 && errno == EINTR);
+	return got > 0 ? (size_t) got : 0;
+}
+
+scanner_t *
+scanner_init_fd(int fd, size_t chunk)
+{
+	return scanner_init_reader(scanner_read_fd, (void *) (intptr_t) fd,
+	                           chunk);
+}
+
+char *
+scanner_read_all(int fd, size_t *len)
+{
+	char *data = NULL, *grown;
+	size_t cap = 0;
+	ssize_t got;
+
+	*len = 0;
+	for (;;) {
+		if (*len + SCANNER_PADDING >= cap) {
+			cap = cap ? cap * 2 : SCANNER_CHUNK;
+			if ((grown = realloc(data, cap)) == NULL) {
+				free(data);
+				errno = ENOMEM;
+				return NULL;
+			}
+			data = grown;
+		}
+		got = read(fd, data + *len, cap - SCANNER_PADDING - *len);
+		if (got == 0) {
+			break;
+		} else if (got == -1 && errno != EINTR) {
+			free(data);
+			return NULL;
+		} else if (got > 0) {
+			*len += got;
+		}
+	}
+	memset(data + *len, 0, SCANNER_PADDING);
+	return data;
+}
+
+scanner_t *
+scanner_init_read(int fd)
+{
+	scanner_t *scanner;
+	char *data;
+	size_t len;
+
+	if ((data = scanner_read_all(fd, &len)) == NULL) {
+		return NULL;
+	}
+	if ((scanner = scanner_setup(data, len, 1)) == NULL) {
+		free(data);
+		errno = ENOMEM;
+	}
 	return scanner;
 }
 
 void
 scanner_free(scanner_t *scanner)
 {
+	if (scanner->owned) {
+		free(scanner->buffer);
+	}
+	if (scanner->mapped) {
+		munmap(scanner->buffer, scanner->mapped);
+	}
+	free(scanner->lines);
+	if (!scanner->numbers_borrowed) {
+		free(scanner->numbers);
+	}
 	free(scanner);
 }
 
-token_t *
-scanner_next(scanner_t *scanner)
+static int
+scanner_index_lines(scanner_t *scanner)
+{
+	size_t count, i;
+
+	// the first line starts at the beginning, the rest after a newline
+	count = scanner->scan->newlines(scanner->buffer, 0, NULL);
+	scanner->lines = malloc(sizeof(unsigned int) * (count + 1));
+	if (scanner->lines == NULL) {
+		return 0;
+	}
+	scanner->lines[0] = 0;
+	scanner->scan->newlines(scanner->buffer, 0, scanner->lines + 1);
+	for (i = 1; i <= count; i++) {
+		scanner->lines[i]++;
+	}
+	scanner->nlines = count + 1;
+	return 1;
+}
+
+static int
+scanner_window_position(scanner_t *scanner,
+                        unsigned int offset,
+                        unsigned int *line,
+                        unsigned int *col)
+{
+	unsigned int rel = offset - scanner->base, start = scanner->line_start;
+	const char *nl = scanner->buffer, *end;
+
+	// the padding check lets through an EOF right after a lone BOM
+	if (rel > scanner->len + SCANNER_PADDING) {
+		return 0; // already dropped from the window
+	}
+	end = scanner->buffer + rel;
+	*line = scanner->line_base + 1;
+	while ((nl = memchr(nl, '\n', end - nl)) != NULL) {
+		nl++;
+		(*line)++;
+		start = scanner->base + (nl - scanner->buffer);
+	}
+	*col = offset - start + 1;
+	return 1;
+}
+
+int
+scanner_position(scanner_t *scanner,
+                 unsigned int offset,
+                 unsigned int *line,
+                 unsigned int *col)
+{
+	unsigned int low = 0, high, mid;
+
+	if (scanner->read != NULL) {
+		return scanner_window_position(scanner, offset, line, col);
+	}
+	if (scanner->lines == NULL && !scanner_index_lines(scanner)) {
+		return 0;
+	}
+
+	// find the last line that starts before the offset
+	high = scanner->nlines;
+	while (high - low > 1) {
+		mid = low + (high - low) / 2;
+		if (scanner->lines[mid] <= offset) {
+			low = mid;
+		} else {
+			high = mid;
+		}
+	}
+
+	*line = low + 1;
+	*col = offset - scanner->lines[low] + 1;
+	return 1;
+}
+
+const number_t *
+scanner_numbers(scanner_t *scanner, unsigned int *count)
+{
+	*count = scanner->nnumbers;
+	return scanner->numbers;
+}
+
+void
+scanner_use_numbers(scanner_t *scanner,
+                    const number_t *numbers,
+                    unsigned int count)
+{
+	if (!scanner->numbers_borrowed) {
+		free(scanner->numbers);
+	}
+	scanner->numbers = (number_t *) numbers;
+	scanner->nnumbers = count;
+	scanner->numbers_cap = count;
+	scanner->numbers_borrowed = 1;
+}
+
+int
+scanner_failed(scanner_t *scanner)
+{
+	return scanner->failed;
+}
+
+const char *
+scanner_source(scanner_t *scanner)
+{
+	return scanner->read ? NULL : scanner->buffer;
+}
+
+const number_t *
+scanner_number(scanner_t *scanner, const token_t *token)
+{
+	if (token->type != TOK_DIGIT || token->value == 0
+	    || token->value > scanner->nnumbers) {
+		return NULL;
+	}
+	return &scanner->numbers[token->value - 1];
+}
+
+void
+scanner_set_symtab(scanner_t *scanner, symtab_t *symtab)
+{
+	scanner->symtab = symtab;
+}
+
+void
+scanner_set_strarena(scanner_t *scanner, strarena_t *strarena)
+{
+	scanner->strarena = strarena;
+}
+
+size_t
+scanner_length(scanner_t *scanner)
+{
+	return scanner->len;
+}
+
+const char *
+scanner_lexeme(scanner_t *scanner, const token_t *token)
+{
+	unsigned int rel = token->offset - scanner->base;
+
+	// tokens before the window wrap around to a large offset
+	if (rel > scanner->len || token->length > scanner->len - rel) {
+		return NULL;
+	}
+	return scanner->buffer + rel;
+}
+
+char *
+scanner_lexeme_dup(scanner_t *scanner, const token_t *token)
+{
+	const char *lexeme;
+	char *copy;
+
+	if ((lexeme = scanner_lexeme(scanner, token)) == NULL) {
+		return NULL;
+	}
+	if ((copy = malloc(sizeof(char) * token->length + 1)) != NULL) {
+		memcpy(copy, lexeme, token->length);
+		copy[token->length] = 0;
+	}
+	return copy;
+}
+
+static token_t
+scanner_scan(scanner_t *scanner)
 {
 	scanner_clean(scanner);
-	int next = scanner_peek(scanner);
-	token_t *token;
-
-	if (next == EOF) {
-		return alloc_token(scanner, TOK_EOF);
-	}
-
-	switch (next) {
-	case '*':
-		token = alloc_token(scanner, TOK_ASTERISK);
-		scanner_discard(scanner);
-		return token;
-	case '@':
-		token = alloc_token(scanner, TOK_AT);
-		scanner_discard(scanner);
-		return token;
-	case '^':
-		token = alloc_token(scanner, TOK_CARET);
-		scanner_discard(scanner);
-		return token;
-	case ':':
-		if (scanner_peekfar(scanner, 1) == '=') {
-			token = alloc_token(scanner, TOK_ASSIGN);
-			scanner_discard(scanner);
-			scanner_discard(scanner);
-			return token;
+	char next = scanner_peek(scanner);
+
+	if (next == 0) {
+		return make_token(scanner, TOK_EOF);
+	}
+
+	switch (CHARCLASS(next)) {
+	case CHAR_SYMBOL:
+		return scanner_read_as_symbol(scanner, next);
+	case CHAR_ALPHA:
+		return scanner_read_as_identifier(scanner);
+	case CHAR_DIGIT:
+		return scanner_read_as_number(scanner);
+	case CHAR_QUOTE:
+		return scanner_read_as_string(scanner);
+	default:
+		return make_token(scanner, TOK_EOF);
+	}
+}
+
+/* Stores the value of a number token in the table of numbers. Returns its
+ * index plus one, or 0 if out of memory. */
+static unsigned int
+scanner_add_number(scanner_t *scanner, const token_t *token)
+{
+	number_t *next;
+	unsigned int cap;
+
+	if (scanner->numbers_borrowed) {
+		return 0;
+	}
+	if (scanner->nnumbers == scanner->numbers_cap) {
+		cap = scanner->numbers_cap ? scanner->numbers_cap * 2 : 64;
+		next = realloc(scanner->numbers, sizeof(number_t) * cap);
+		if (next == NULL) {
+			return 0;
 		}
-		token = alloc_token(scanner, TOK_COLON);
-		scanner_discard(scanner);
-		return token;
-	case ',':
-		token = alloc_token(scanner, TOK_COMMA);
-		scanner_discard(scanner);
-		return token;
-	case '$':
-		token = alloc_token(scanner, TOK_DOLLAR);
-		scanner_discard(scanner);
-		return token;
-	case '.':
-		if (scanner_peekfar(scanner, 1) == '.') {
-			token = alloc_token(scanner, TOK_DOTDOT);
-			scanner_discard(scanner);
-			scanner_discard(scanner);
-			return token;
+		scanner->numbers = next;
+		scanner->numbers_cap = cap;
+	}
+	if (!number_parse(scanner_lexeme(scanner, token), token->length,
+	                  &scanner->numbers[scanner->nnumbers])) {
+		return 0;
+	}
+	return ++scanner->nnumbers;
+}
+
+/*
+ * Decodes a string literal into the string arena. Every quoted part adds
+ * its characters, and a quote too if it comes right after another quoted
+ * part, since 'it''s' is two of them. Every control code adds one
+ * character. That is never longer than the literal itself.
+ */
+static unsigned int
+scanner_add_string(scanner_t *scanner, const token_t *token)
+{
+	const char *raw = scanner_lexeme(scanner, token);
+	unsigned int i = 0, len = 0, code;
+	int quoted = 0;
+	char *dest;
+
+	dest = strarena_reserve(scanner->strarena, token->length);
+	if (dest == NULL) {
+		return STRARENA_NONE;
+	}
+	while (i < token->length) {
+		if (raw[i] == '\'') {
+			if (quoted) {
+				dest[len++] = '\'';
+			}
+			for (i++; i < token->length && raw[i] != '\''; i++) {
+				dest[len++] = raw[i];
+			}
+			i++; // the closing quote, if there is one
+			quoted = 1;
 		} else {
-			token = alloc_token(scanner, TOK_DOT);
-			scanner_discard(scanner);
-			return token;
+			// a control code: # and its digits. only the low
+			// byte of codes over 255 is kept.
+			for (i++, code = 0;
+			     i < token->length && CHARCLASS(raw[i]) & CHAR_DIGIT;
+			     i++) {
+				code = code * 10 + (raw[i] - '0');
+			}
+			dest[len++] = (char) code;
+			quoted = 0;
 		}
-	case '=':
-		token = alloc_token(scanner, TOK_EQUAL);
-		scanner_discard(scanner);
-		return token;
-	case '>':
-		if (scanner_peekfar(scanner, 1) == '=') {
-			token = alloc_token(scanner, TOK_GREATEQL);
-			scanner_discard(scanner);
-			scanner_discard(scanner);
-			return token;
+	}
+	return strarena_commit(scanner->strarena, len);
+}
+
+/*
+ * Fills in the value of a token once it is final, or else tokens cut at
+ * the end of a chunk would be interned or converted too.
+ */
+static void
+scanner_finish(scanner_t *scanner, token_t *token)
+{
+	if (token->type == TOK_IDENTIFIER && scanner->symtab) {
+		token->value = symtab_intern(scanner->symtab,
+		                             scanner_lexeme(scanner, token),
+		                             token->length);
+	} else if (token->type == TOK_DIGIT) {
+		token->value = scanner_add_number(scanner, token);
+	} else if (token->type == TOK_STRING && scanner->strarena) {
+		token->value = scanner_add_string(scanner, token);
+	}
+}
+
+token_t
+scanner_next(scanner_t *scanner)
+{
+	unsigned int start;
+	token_t token;
+
+	for (;;) {
+		start = scanner->pos;
+		token = scanner_scan(scanner);
+		if (scanner->eof
+		    || scanner->pos + SCANNER_LOOKAHEAD < scanner->len) {
+			break;
+		}
+		// the token may continue in the next chunk
+		scanner->pos = start;
+		scanner->eof = !scanner_refill(scanner, start);
+	}
+
+	if (scanner->read) {
+		// lexemes of older tokens are gone, so are their numbers
+		scanner->nnumbers = 0;
+	}
+	scanner_finish(scanner, &token);
+	return token;
+}
+
+/* Below this many bytes per thread, starting it costs more than it saves. */
+#define SCANNER_PARALLEL_MIN 65536
+
+/*
+ * Offset of the first whitespace at or after target that is outside any
+ * string or comment, or of the end of the input if there is none. The
+ * walk starts at pos, which must be outside them too, and only looks at
+ * the characters that can open one, which can only appear at the start of
+ * a token outside strings and comments, so they always open one.
+ */
+static unsigned int
+scanner_split_point(scanner_t *scanner, unsigned int pos, unsigned int target)
+{
+	const char *buf = scanner->buffer;
+	unsigned int next;
+
+	for (;;) {
+		next = pos + strcspn(buf + pos, "{(/'");
+		for (pos = pos < target ? target : pos; pos < next; pos++) {
+			if (CHARCLASS(buf[pos]) & CHAR_SPACE) {
+				return pos;
+			}
+		}
+
+		switch (buf[next]) {
+		case 0:
+			return next;
+		case '{':
+			pos = scanner->scan->find(buf, next, '}');
+			pos += buf[pos] != 0;
+			break;
+		case '(':
+			scanner->pos = next;
+			if (buf[next + 1] == '*') {
+				consume_until_closing_trigraph(scanner);
+				pos = scanner->pos;
+			} else {
+				pos = next + 1;
+			}
+			break;
+		case '/':
+			if (buf[next + 1] == '/') {
+				pos = scanner->scan->find(buf, next, '\n');
+			} else {
+				pos = next + 1;
+			}
+			break;
+		case '\'':
+			pos = scanner->scan->find(buf, next + 1, '\'');
+			pos += buf[pos] != 0;
+			break;
+		}
+	}
+}
+
+/*
+ * A part of the input scanned by one thread, from the position of its
+ * scanner until the first token that starts at end or later. The chunk
+ * that has the TOK_EOF is the last one that counts.
+ */
+struct scanner_job {
+	struct scanner scanner;
+	unsigned int end;
+	tokstream_t tokens;
+	int eof;
+	int failed;
+};
+
+static void *
+scanner_job_run(void *arg)
+{
+	struct scanner_job *job = arg;
+	token_t token;
+
+	if (!tokstream_reserve(&job->tokens,
+	                       (job->end - job->scanner.pos) / 4 + 1)) {
+		job->failed = 1;
+		return NULL;
+	}
+	for (;;) {
+		token = scanner_scan(&job->scanner);
+		if (token.type != TOK_EOF && token.offset >= job->end) {
+			return NULL;
+		}
+		if (!tokstream_push(&job->tokens, token)) {
+			job->failed = 1;
+			return NULL;
+		}
+		if (token.type == TOK_EOF) {
+			job->eof = 1;
+			return NULL;
+		}
+	}
+}
+
+/*
+ * Threads only scan, since they would have to share the symbol table, the
+ * string arena and the table of numbers. Token values are filled in once
+ * every chunk is in place, in order, so that they are the same they would
+ * have been if the tokens had been scanned sequentially.
+ */
+static void
+scanner_finish_stream(scanner_t *scanner, tokstream_t *stream, unsigned int i)
+{
+	token_t token;
+
+	for (; i < stream->len; i++) {
+		if (stream->types[i] == TOK_IDENTIFIER
+		    || stream->types[i] == TOK_DIGIT
+		    || stream->types[i] == TOK_STRING) {
+			token = tokstream_get(stream, i);
+			scanner_finish(scanner, &token);
+			stream->values[i] = token.value;
+		}
+	}
+}
+
+static int
+scanner_tokenize_serial(scanner_t *scanner, tokstream_t *stream)
+{
+	token_t token;
+
+	do {
+		token = scanner_next(scanner);
+		if (!tokstream_push(stream, token)) {
+			return 0;
+		}
+	} while (token.type != TOK_EOF);
+	return !scanner->failed;
+}
+
+int
+scanner_tokenize(scanner_t *scanner, tokstream_t *stream, unsigned int threads)
+{
+	struct scanner_job *jobs;
+	struct scanner walk;
+	pthread_t *tids;
+	int *started;
+	unsigned int i, pos, step, first, ok = 1;
+
+	if (scanner->read != NULL || scanner->pos >= scanner->len) {
+		return scanner_tokenize_serial(scanner, stream);
+	}
+	if (threads > (scanner->len - scanner->pos) / SCANNER_PARALLEL_MIN) {
+		threads = (scanner->len - scanner->pos) / SCANNER_PARALLEL_MIN;
+	}
+	if (threads <= 1) {
+		return scanner_tokenize_serial(scanner, stream);
+	}
+
+	jobs = calloc(threads, sizeof(struct scanner_job));
+	tids = calloc(threads, sizeof(pthread_t));
+	started = calloc(threads, sizeof(int));
+	if (jobs == NULL || tids == NULL || started == NULL) {
+		free(jobs);
+		free(tids);
+		free(started);
+		return scanner_tokenize_serial(scanner, stream);
+	}
+
+	walk = *scanner;
+	first = stream->len;
+	pos = scanner->pos;
+	step = (scanner->len - pos) / threads;
+	for (i = 0; i < threads; i++) {
+		jobs[i].scanner = *scanner;
+		jobs[i].scanner.pos = pos;
+		if (i + 1 < threads) {
+			pos = scanner_split_point(&walk, pos,
+			                          scanner->pos + step * (i + 1));
+			jobs[i].end = pos;
 		} else {
-			token = alloc_token(scanner, TOK_GREATER);
-			scanner_discard(scanner);
-			return token;
+			jobs[i].end = UINT_MAX;
 		}
-	case '[':
-		token = alloc_token(scanner, TOK_LBRACKET);
-		scanner_discard(scanner);
-		return token;
-	case '<':
-		if (scanner_peekfar(scanner, 1) == '=') {
-			token = alloc_token(scanner, TOK_LESSEQL);
-			scanner_discard(scanner);
-			scanner_discard(scanner);
-			return token;
-		} else if (scanner_peekfar(scanner, 1) == '>') {
-			token = alloc_token(scanner, TOK_NEQUAL);
-			scanner_discard(scanner);
-			scanner_discard(scanner);
-			return token;
+		tokstream_init(&jobs[i].tokens);
+	}
+
+	// the calling thread takes the first chunk
+	for (i = 1; i < threads; i++) {
+		started[i] = !pthread_create(&tids[i], NULL, scanner_job_run,
+		                             &jobs[i]);
+	}
+	scanner_job_run(&jobs[0]);
+	for (i = 1; i < threads; i++) {
+		if (started[i]) {
+			pthread_join(tids[i], NULL);
 		} else {
-			token = alloc_token(scanner, TOK_LESSER);
-			scanner_discard(scanner);
-			return token;
+			scanner_job_run(&jobs[i]);
 		}
-	case '(':
-		token = alloc_token(scanner, TOK_LPAREN);
-		scanner_discard(scanner);
-		return token;
-	case '-':
-		token = alloc_token(scanner, TOK_MINUS);
-		scanner_discard(scanner);
-		return token;
-	case '+':
-		token = alloc_token(scanner, TOK_PLUS);
-		scanner_discard(scanner);
-		return token;
-	case ']':
-		token = alloc_token(scanner, TOK_RBRACKET);
-		scanner_discard(scanner);
-		return token;
-	case ')':
-		token = alloc_token(scanner, TOK_RPAREN);
-		scanner_discard(scanner);
-		return token;
-	case ';':
-		token = alloc_token(scanner, TOK_SEMICOLON);
-		scanner_discard(scanner);
-		return token;
-	case '/':
-		token = alloc_token(scanner, TOK_SLASH);
-		scanner_discard(scanner);
-		return token;
-	}
-
-	if (next >= '0' && next <= '9') {
-		return scanner_read_as_number(scanner);
 	}
-	if (isupper(next) || islower(next) || next == '_') {
-		return scanner_read_as_identifier(scanner);
+
+	for (i = 0; i < threads && ok; i++) {
+		ok = !jobs[i].failed && tokstream_append(stream, &jobs[i].tokens);
+		if (jobs[i].eof) {
+			break;
+		}
 	}
-	if (next == '\'' || next == '#') {
-		return scanner_read_as_string(scanner);
+	if (ok) {
+		// leave the scanner where scanner_next would have
+		scanner->pos = stream->offsets[stream->len - 1] - scanner->base;
+		scanner_finish_stream(scanner, stream, first);
 	}
 
-	return alloc_token(scanner, TOK_EOF);
+	for (i = 0; i < threads; i++) {
+		tokstream_free(&jobs[i].tokens);
+	}
+	free(jobs);
+	free(tids);
+	free(started);
+	return ok;
 }
@@ -0,0 +1,82 @@
+/* libpasta -- an AST parser for Pascal
+ * Copyright (C) 2024 Dani Rodríguez <dani@danirod.es>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "strarena.h"
+#include "intern.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Strings are interned as they are, see intern.h. */
+struct strarena {
+	struct intern strings;
+};
+
+#define STRARENA_INITIAL_SLOTS 256
+
+strarena_t *
+strarena_new(void)
+{
+	strarena_t *arena = malloc(sizeof(strarena_t));
+
+	if (arena && !intern_init(&arena->strings, STRARENA_INITIAL_SLOTS)) {
+		free(arena);
+		return NULL;
+	}
+	return arena;
+}
+
+void
+strarena_free(strarena_t *arena)
+{
+	intern_destroy(&arena->strings);
+	free(arena);
+}
+
+char *
+strarena_reserve(strarena_t *arena, unsigned int len)
+{
+	return intern_reserve(&arena->strings, len);
+}
+
+uint32_t
+strarena_commit(strarena_t *arena, unsigned int len)
+{
+	return intern_commit(&arena->strings, len);
+}
+
+uint32_t
+strarena_add(strarena_t *arena, const char *data, unsigned int len)
+{
+	char *dest;
+
+	if ((dest = strarena_reserve(arena, len)) == NULL) {
+		return STRARENA_NONE;
+	}
+	memcpy(dest, data, len);
+	return strarena_commit(arena, len);
+}
+
+const char *
+strarena_get(strarena_t *arena, uint32_t id, unsigned int *len)
+{
+	return intern_get(&arena->strings, id, len);
+}
+
+unsigned int
+strarena_count(strarena_t *arena)
+{
+	return arena->strings.count;
+}
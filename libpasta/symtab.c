@@ -0,0 +1,83 @@
+/* libpasta -- an AST parser for Pascal
+ * Copyright (C) 2024 Dani Rodríguez <dani@danirod.es>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "symtab.h"
+#include "intern.h"
+#include <stdlib.h>
+
+/*
+ * Names are interned folded, so that the same name in any case is the
+ * same string, see intern.h.
+ */
+struct symtab {
+	struct intern names;
+};
+
+#define SYMTAB_INITIAL_SLOTS 1024
+
+/* Lowercase version of an identifier character. Identifiers only have
+ * letters, digits and underscores, so only A-Z need to change. */
+static char
+fold(char ch)
+{
+	return (unsigned char) (ch - 'A') < 26 ? ch + ('a' - 'A') : ch;
+}
+
+symtab_t *
+symtab_new(void)
+{
+	symtab_t *symtab = malloc(sizeof(symtab_t));
+
+	if (symtab && !intern_init(&symtab->names, SYMTAB_INITIAL_SLOTS)) {
+		free(symtab);
+		return NULL;
+	}
+	return symtab;
+}
+
+void
+symtab_free(symtab_t *symtab)
+{
+	intern_destroy(&symtab->names);
+	free(symtab);
+}
+
+uint32_t
+symtab_intern(symtab_t *symtab, const char *name, unsigned int len)
+{
+	unsigned int i;
+	char *folded;
+
+	if ((folded = intern_reserve(&symtab->names, len)) == NULL) {
+		return SYMTAB_NONE;
+	}
+	for (i = 0; i < len; i++) {
+		folded[i] = fold(name[i]);
+	}
+	return intern_commit(&symtab->names, len);
+}
+
+const char *
+symtab_name(symtab_t *symtab, uint32_t id)
+{
+	return intern_get(&symtab->names, id, NULL);
+}
+
+unsigned int
+symtab_count(symtab_t *symtab)
+{
+	return symtab->names.count;
+}
@@ -16,131 +16,237 @@
  */
 #include "token.h"
 #include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
 
-struct tokeninfo {
-	tokentype_t token;
-	const char *str;
-};
-
-struct keyword {
-	const char *equiv;
-	tokentype_t token;
-};
+#define TOKENINFO(token) [token] = #token
 
-#define TOKENINFO(token) \
-	{ \
-		token, #token \
-	}
-
-struct tokeninfo tokens[] = {
-    TOKENINFO(TOK_EOF),        TOKENINFO(TOK_AND),
-    TOKENINFO(TOK_ARRAY),      TOKENINFO(TOK_ASSIGN),
-    TOKENINFO(TOK_ASTERISK),   TOKENINFO(TOK_AT),
-    TOKENINFO(TOK_BEGIN),      TOKENINFO(TOK_CARET),
-    TOKENINFO(TOK_CASE),       TOKENINFO(TOK_COLON),
-    TOKENINFO(TOK_COMMA),      TOKENINFO(TOK_CONST),
-    TOKENINFO(TOK_CTRLCODE),   TOKENINFO(TOK_DIGIT),
-    TOKENINFO(TOK_DIV),        TOKENINFO(TOK_DO),
-    TOKENINFO(TOK_DOLLAR),     TOKENINFO(TOK_DOT),
-    TOKENINFO(TOK_DOTDOT),     TOKENINFO(TOK_DOWNTO),
-    TOKENINFO(TOK_ELSE),       TOKENINFO(TOK_END),
-    TOKENINFO(TOK_EQUAL),      TOKENINFO(TOK_EXIT),
-    TOKENINFO(TOK_FILE),       TOKENINFO(TOK_FOR),
-    TOKENINFO(TOK_FUNCTION),   TOKENINFO(TOK_GOTO),
-    TOKENINFO(TOK_GREATEQL),   TOKENINFO(TOK_GREATER),
-    TOKENINFO(TOK_IDENTIFIER), TOKENINFO(TOK_IF),
-    TOKENINFO(TOK_IN),         TOKENINFO(TOK_LBRACKET),
-    TOKENINFO(TOK_LESSEQL),    TOKENINFO(TOK_LESSER),
-    TOKENINFO(TOK_LPAREN),     TOKENINFO(TOK_MINUS),
-    TOKENINFO(TOK_MOD),        TOKENINFO(TOK_NEQUAL),
-    TOKENINFO(TOK_NIL),        TOKENINFO(TOK_NOT),
-    TOKENINFO(TOK_OF),         TOKENINFO(TOK_OR),
-    TOKENINFO(TOK_PACKED),     TOKENINFO(TOK_PLUS),
-    TOKENINFO(TOK_PROCEDURE),  TOKENINFO(TOK_PROGRAM),
-    TOKENINFO(TOK_RBRACKET),   TOKENINFO(TOK_RECORD),
-    TOKENINFO(TOK_REPEAT),     TOKENINFO(TOK_RPAREN),
-    TOKENINFO(TOK_SEMICOLON),  TOKENINFO(TOK_SET),
-    TOKENINFO(TOK_SLASH),      TOKENINFO(TOK_STRING),
-    TOKENINFO(TOK_THEN),       TOKENINFO(TOK_TO),
-    TOKENINFO(TOK_TYPE),       TOKENINFO(TOK_UNTIL),
-    TOKENINFO(TOK_VAR),        TOKENINFO(TOK_WHILE),
-    TOKENINFO(TOK_WITH),       {0, 0},
-};
+const token_t token_none = {TOK_NONE, 0, 0, 0};
 
-struct keyword keywords[] = {
-    {"and", TOK_AND},         {"array", TOK_ARRAY},
-    {"begin", TOK_BEGIN},     {"case", TOK_CASE},
-    {"const", TOK_CONST},     {"div", TOK_DIV},
-    {"do", TOK_DO},           {"downto", TOK_DOWNTO},
-    {"else", TOK_ELSE},       {"end", TOK_END},
-    {"exit", TOK_EXIT},       {"file", TOK_FILE},
-    {"for", TOK_FOR},         {"function", TOK_FUNCTION},
-    {"goto", TOK_GOTO},       {"if", TOK_IF},
-    {"in", TOK_IN},           {"mod", TOK_MOD},
-    {"nil", TOK_NIL},         {"not", TOK_NOT},
-    {"of", TOK_OF},           {"or", TOK_OR},
-    {"packed", TOK_PACKED},   {"procedure", TOK_PROCEDURE},
-    {"program", TOK_PROGRAM}, {"record", TOK_RECORD},
-    {"repeat", TOK_REPEAT},   {"set", TOK_SET},
-    {"then", TOK_THEN},       {"to", TOK_TO},
-    {"type", TOK_TYPE},       {"until", TOK_UNTIL},
-    {"var", TOK_VAR},         {"while", TOK_WHILE},
-    {"with", TOK_WITH},       {0, 0},
+/* Names of the token types, indexed by type. */
+static const char *const tokens[] = {
+    TOKENINFO(TOK_NONE),
+    TOKENINFO(TOK_EOF),
+    TOKENINFO(TOK_AND),
+    TOKENINFO(TOK_ARRAY),
+    TOKENINFO(TOK_ASSIGN),
+    TOKENINFO(TOK_ASTERISK),
+    TOKENINFO(TOK_AT),
+    TOKENINFO(TOK_BEGIN),
+    TOKENINFO(TOK_CARET),
+    TOKENINFO(TOK_CASE),
+    TOKENINFO(TOK_COLON),
+    TOKENINFO(TOK_COMMA),
+    TOKENINFO(TOK_CONST),
+    TOKENINFO(TOK_CTRLCODE),
+    TOKENINFO(TOK_DIGIT),
+    TOKENINFO(TOK_DIV),
+    TOKENINFO(TOK_DO),
+    TOKENINFO(TOK_DOLLAR),
+    TOKENINFO(TOK_DOT),
+    TOKENINFO(TOK_DOTDOT),
+    TOKENINFO(TOK_DOWNTO),
+    TOKENINFO(TOK_ELSE),
+    TOKENINFO(TOK_END),
+    TOKENINFO(TOK_EQUAL),
+    TOKENINFO(TOK_EXIT),
+    TOKENINFO(TOK_FILE),
+    TOKENINFO(TOK_FOR),
+    TOKENINFO(TOK_FUNCTION),
+    TOKENINFO(TOK_GOTO),
+    TOKENINFO(TOK_GREATEQL),
+    TOKENINFO(TOK_GREATER),
+    TOKENINFO(TOK_IDENTIFIER),
+    TOKENINFO(TOK_IF),
+    TOKENINFO(TOK_IN),
+    TOKENINFO(TOK_LBRACKET),
+    TOKENINFO(TOK_LESSEQL),
+    TOKENINFO(TOK_LESSER),
+    TOKENINFO(TOK_LPAREN),
+    TOKENINFO(TOK_MINUS),
+    TOKENINFO(TOK_MOD),
+    TOKENINFO(TOK_NEQUAL),
+    TOKENINFO(TOK_NIL),
+    TOKENINFO(TOK_NOT),
+    TOKENINFO(TOK_OF),
+    TOKENINFO(TOK_OR),
+    TOKENINFO(TOK_PACKED),
+    TOKENINFO(TOK_PLUS),
+    TOKENINFO(TOK_PROCEDURE),
+    TOKENINFO(TOK_PROGRAM),
+    TOKENINFO(TOK_RBRACKET),
+    TOKENINFO(TOK_RECORD),
+    TOKENINFO(TOK_REPEAT),
+    TOKENINFO(TOK_RPAREN),
+    TOKENINFO(TOK_SEMICOLON),
+    TOKENINFO(TOK_SET),
+    TOKENINFO(TOK_SLASH),
+    TOKENINFO(TOK_STRING),
+    TOKENINFO(TOK_THEN),
+    TOKENINFO(TOK_TO),
+    TOKENINFO(TOK_TYPE),
+    TOKENINFO(TOK_UNTIL),
+    TOKENINFO(TOK_VAR),
+    TOKENINFO(TOK_WHILE),
+    TOKENINFO(TOK_WITH),
 };
 
-static void
-lowercase(char *str)
+/*
+ * Compares an identifier lexeme with a lowercase keyword of the same length.
+ * The lexeme only contains letters, digits and underscores, so setting bit
+ * 0x20 folds uppercase letters without turning anything else into a letter
+ * (digits already have it set, and '_' becomes DEL).
+ */
+static int
+keyword_eq(const char *input, const char *keyword, unsigned int len)
 {
-	char *c = str;
-	while (c && *c) {
-		if (*c >= 'A' && *c <= 'Z') {
-			*c = (*c) + 0x20;
+	unsigned int i;
+
+	for (i = 0; i < len; i++) {
+		if ((input[i] | 0x20) != keyword[i]) {
+			return 0;
 		}
-		c++;
 	}
+	return 1;
 }
 
+#define KEYWORD(word, tok) \
+	if (keyword_eq(input, word, len)) \
+		return tok
+
+/*
+ * Keywords are found by switching on the length of the lexeme and then on
+ * its first character folded to lowercase, so at most two comparisons are
+ * done and no copy of the lexeme is ever made.
+ */
 tokentype_t
-match_identifier(char *input)
+match_identifier(const char *input, unsigned int len)
 {
-	struct keyword *kw;
-	char *lower;
-
-	/* create a copy of the string in order to manipulate it */
-	lower = strdup(input);
-	lowercase(lower);
-
-	for (kw = keywords; kw->equiv; kw++) {
-		if (!strcmp(lower, kw->equiv)) {
-			free(lower);
-			return kw->token;
+	switch (len) {
+	case 2:
+		switch (input[0] | 0x20) {
+		case 'd':
+			KEYWORD("do", TOK_DO);
+			break;
+		case 'i':
+			KEYWORD("if", TOK_IF);
+			KEYWORD("in", TOK_IN);
+			break;
+		case 'o':
+			KEYWORD("of", TOK_OF);
+			KEYWORD("or", TOK_OR);
+			break;
+		case 't':
+			KEYWORD("to", TOK_TO);
+			break;
+		}
+		break;
+	case 3:
+		switch (input[0] | 0x20) {
+		case 'a':
+			KEYWORD("and", TOK_AND);
+			break;
+		case 'd':
+			KEYWORD("div", TOK_DIV);
+			break;
+		case 'e':
+			KEYWORD("end", TOK_END);
+			break;
+		case 'f':
+			KEYWORD("for", TOK_FOR);
+			break;
+		case 'm':
+			KEYWORD("mod", TOK_MOD);
+			break;
+		case 'n':
+			KEYWORD("nil", TOK_NIL);
+			KEYWORD("not", TOK_NOT);
+			break;
+		case 's':
+			KEYWORD("set", TOK_SET);
+			break;
+		case 'v':
+			KEYWORD("var", TOK_VAR);
+			break;
+		}
+		break;
+	case 4:
+		switch (input[0] | 0x20) {
+		case 'c':
+			KEYWORD("case", TOK_CASE);
+			break;
+		case 'e':
+			KEYWORD("else", TOK_ELSE);
+			KEYWORD("exit", TOK_EXIT);
+			break;
+		case 'f':
+			KEYWORD("file", TOK_FILE);
+			break;
+		case 'g':
+			KEYWORD("goto", TOK_GOTO);
+			break;
+		case 't':
+			KEYWORD("then", TOK_THEN);
+			KEYWORD("type", TOK_TYPE);
+			break;
+		case 'w':
+			KEYWORD("with", TOK_WITH);
+			break;
 		}
+		break;
+	case 5:
+		switch (input[0] | 0x20) {
+		case 'a':
+			KEYWORD("array", TOK_ARRAY);
+			break;
+		case 'b':
+			KEYWORD("begin", TOK_BEGIN);
+			break;
+		case 'c':
+			KEYWORD("const", TOK_CONST);
+			break;
+		case 'u':
+			KEYWORD("until", TOK_UNTIL);
+			break;
+		case 'w':
+			KEYWORD("while", TOK_WHILE);
+			break;
+		}
+		break;
+	case 6:
+		switch (input[0] | 0x20) {
+		case 'd':
+			KEYWORD("downto", TOK_DOWNTO);
+			break;
+		case 'p':
+			KEYWORD("packed", TOK_PACKED);
+			break;
+		case 'r':
+			KEYWORD("record", TOK_RECORD);
+			KEYWORD("repeat", TOK_REPEAT);
+			break;
+		}
+		break;
+	case 7:
+		KEYWORD("program", TOK_PROGRAM);
+		break;
+	case 8:
+		KEYWORD("function", TOK_FUNCTION);
+		break;
+	case 9:
+		KEYWORD("procedure", TOK_PROCEDURE);
+		break;
 	}
 
-	free(lower);
 	return TOK_IDENTIFIER;
 }
 
+#undef KEYWORD
+
 const char *
 tokentype_string(tokentype_t tok)
 {
-	struct tokeninfo *tt = tokens;
-	while (tt->str) {
-		if (tt->token == tok) {
-			return tt->str;
-		}
-		tt++;
-	}
-	return "<null>";
-}
-
-void
-token_free(token_t *token)
-{
-	// if there is no meta, nothing should be freed
-	if (token->meta) {
-		free(token->meta);
+	if ((unsigned int) tok >= sizeof(tokens) / sizeof(tokens[0])
+	    || tokens[tok] == NULL) {
+		return "<null>";
 	}
+	return tokens[tok];
 }
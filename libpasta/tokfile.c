@@ -0,0 +1,249 @@
+/* libpasta -- an AST parser for Pascal
+ * Copyright (C) 2024 Dani Rodríguez <dani@danirod.es>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "tokfile.h"
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define TOKFILE_MAGIC "PTOK"
+#define TOKFILE_BYTE_ORDER 0x0102
+#define TOKFILE_ALIGN 8
+
+/*
+ * Every section is described by its offset from the start of the file.
+ * The source is followed by SCANNER_PADDING zeros, like a padded scanner
+ * buffer, and the sizes of the rest come from the number of tokens and
+ * numbers.
+ */
+struct tokfile_header {
+	char magic[4];
+	uint16_t version;
+	uint16_t byte_order;
+	uint32_t count;      /* tokens */
+	uint32_t source_len; /* bytes, without the padding */
+	uint32_t nnumbers;
+	uint32_t number_size; /* sizeof(number_t) of the writer */
+	uint64_t source, types, offsets, lengths, values, numbers;
+};
+
+static uint64_t
+align(uint64_t offset)
+{
+	return (offset + TOKFILE_ALIGN - 1) & ~(uint64_t) (TOKFILE_ALIGN - 1);
+}
+
+/* Writes a section at the given offset, filling the gap before it. */
+static int
+write_section(FILE *fp, uint64_t *pos, uint64_t at, const void *data,
+              size_t len)
+{
+	static const char zeros[TOKFILE_ALIGN];
+
+	if (at - *pos > sizeof(zeros)
+	    || fwrite(zeros, 1, at - *pos, fp) != at - *pos) {
+		return 0;
+	}
+	if (len > 0 && fwrite(data, 1, len, fp) != len) {
+		return 0;
+	}
+	*pos = at + len;
+	return 1;
+}
+
+int
+tokfile_write(FILE *fp, scanner_t *scanner, tokstream_t *stream)
+{
+	struct tokfile_header header;
+	const char *source = scanner_source(scanner);
+	const number_t *numbers;
+	number_t *clean = NULL;
+	uint64_t pos = 0;
+	unsigned int nnumbers, i;
+	int ok;
+
+	if (source == NULL) {
+		return 0;
+	}
+	numbers = scanner_numbers(scanner, &nnumbers);
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, TOKFILE_MAGIC, 4);
+	header.version = TOKFILE_VERSION;
+	header.byte_order = TOKFILE_BYTE_ORDER;
+	header.count = stream->len;
+	header.source_len = scanner_length(scanner);
+	header.nnumbers = nnumbers;
+	header.number_size = sizeof(number_t);
+	header.source = align(sizeof(header));
+	header.types = align(header.source + header.source_len
+	                     + SCANNER_PADDING);
+	header.offsets = align(header.types + header.count);
+	header.lengths = align(header.offsets + sizeof(uint32_t) * header.count);
+	header.values = align(header.lengths + sizeof(uint32_t) * header.count);
+	header.numbers = align(header.values + sizeof(uint32_t) * header.count);
+
+	// numbers are copied field by field, so the padding is always zero
+	if (nnumbers > 0) {
+		if ((clean = calloc(nnumbers, sizeof(number_t))) == NULL) {
+			return 0;
+		}
+		for (i = 0; i < nnumbers; i++) {
+			clean[i].flags = numbers[i].flags;
+			clean[i].value = numbers[i].value;
+		}
+	}
+
+	ok = write_section(fp, &pos, 0, &header, sizeof(header))
+	     && write_section(fp, &pos, header.source, source,
+	                      header.source_len + SCANNER_PADDING)
+	     && write_section(fp, &pos, header.types, stream->types,
+	                      header.count)
+	     && write_section(fp, &pos, header.offsets, stream->offsets,
+	                      sizeof(uint32_t) * header.count)
+	     && write_section(fp, &pos, header.lengths, stream->lengths,
+	                      sizeof(uint32_t) * header.count)
+	     && write_section(fp, &pos, header.values, stream->values,
+	                      sizeof(uint32_t) * header.count)
+	     && write_section(fp, &pos, header.numbers, clean,
+	                      sizeof(number_t) * nnumbers);
+	free(clean);
+	return ok;
+}
+
+/* Whether len bytes at offset fit in size bytes, written so that a bogus
+ * offset cannot make the sum overflow. */
+static int
+fits(uint64_t offset, uint64_t len, uint64_t size)
+{
+	return offset <= size && len <= size - offset;
+}
+
+/* Whether the header describes a file that fits in size bytes and that
+ * this build can use. Only the sections are checked, not their contents. */
+static int
+valid_header(const struct tokfile_header *header, uint64_t size)
+{
+	uint64_t count = header->count;
+
+	return !memcmp(header->magic, TOKFILE_MAGIC, 4)
+	       && header->version == TOKFILE_VERSION
+	       && header->byte_order == TOKFILE_BYTE_ORDER
+	       && header->number_size == sizeof(number_t) && count > 0
+	       && header->source % TOKFILE_ALIGN == 0
+	       && header->offsets % TOKFILE_ALIGN == 0
+	       && header->lengths % TOKFILE_ALIGN == 0
+	       && header->values % TOKFILE_ALIGN == 0
+	       && header->numbers % TOKFILE_ALIGN == 0
+	       && fits(header->source,
+	               (uint64_t) header->source_len + SCANNER_PADDING,
+	               size)
+	       && fits(header->types, count, size)
+	       && fits(header->offsets, count * sizeof(uint32_t), size)
+	       && fits(header->lengths, count * sizeof(uint32_t), size)
+	       && fits(header->values, count * sizeof(uint32_t), size)
+	       && fits(header->numbers,
+	               (uint64_t) header->nnumbers * sizeof(number_t),
+	               size);
+}
+
+/*
+ * Whether the contents can be used without reading out of the mapping:
+ * the source is followed by the padding the scanner relies on, every
+ * lexeme is inside the source, every number is in the table and the last
+ * token is TOK_EOF. A stale or damaged file is rejected instead.
+ */
+static int
+valid_contents(const struct tokfile_header *header, const char *map)
+{
+	const char *padding = map + header->source + header->source_len;
+	const uint8_t *types = (const uint8_t *) (map + header->types);
+	const uint32_t *offsets = (const uint32_t *) (map + header->offsets);
+	const uint32_t *lengths = (const uint32_t *) (map + header->lengths);
+	const uint32_t *values = (const uint32_t *) (map + header->values);
+	uint32_t i;
+
+	for (i = 0; i < SCANNER_PADDING; i++) {
+		if (padding[i] != 0) {
+			return 0;
+		}
+	}
+	for (i = 0; i < header->count; i++) {
+		if ((uint64_t) offsets[i] + lengths[i] > header->source_len) {
+			return 0;
+		}
+		if (types[i] == TOK_DIGIT && values[i] > header->nnumbers) {
+			return 0;
+		}
+	}
+	return types[header->count - 1] == TOK_EOF;
+}
+
+int
+parser_load_tokfile(parser_t *parser, int fd)
+{
+	const struct tokfile_header *header;
+	struct stat st;
+	scanner_t *scanner;
+	char *map;
+
+	if (fstat(fd, &st) == -1 || (size_t) st.st_size < sizeof(*header)) {
+		return 0;
+	}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED) {
+		return 0;
+	}
+	header = (const struct tokfile_header *) map;
+	if (!valid_header(header, st.st_size)
+	    || !valid_contents(header, map)) {
+		munmap(map, st.st_size);
+		return 0;
+	}
+
+	scanner = scanner_init_padded(map + header->source, header->source_len);
+	if (scanner == NULL) {
+		munmap(map, st.st_size);
+		return 0;
+	}
+	scanner_use_numbers(scanner,
+	                    (const number_t *) (map + header->numbers),
+	                    header->nnumbers);
+
+	tokstream_free(&parser->tokens);
+	parser->tokens.types = (uint8_t *) (map + header->types);
+	parser->tokens.offsets = (uint32_t *) (map + header->offsets);
+	parser->tokens.lengths = (uint32_t *) (map + header->lengths);
+	parser->tokens.values = (uint32_t *) (map + header->values);
+	parser->tokens.len = header->count;
+	parser->tokens.capacity = header->count;
+	parser->pos = 0;
+	parser->scanner = scanner;
+	parser->mapped = map;
+	parser->mapped_len = st.st_size;
+	return 1;
+}
+
+void
+tokfile_unmap(parser_t *parser)
+{
+	scanner_free(parser->scanner);
+	munmap(parser->mapped, parser->mapped_len);
+	parser->scanner = NULL;
+	parser->mapped = NULL;
+	tokstream_init(&parser->tokens);
+}
@@ -0,0 +1,135 @@
+/* libpasta -- an AST parser for Pascal
+ * Copyright (C) 2024 Dani Rodríguez <dani@danirod.es>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "tokstream.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define TOKSTREAM_MIN_CAPACITY 64
+
+void
+tokstream_init(tokstream_t *stream)
+{
+	stream->types = NULL;
+	stream->offsets = NULL;
+	stream->lengths = NULL;
+	stream->values = NULL;
+	stream->len = 0;
+	stream->capacity = 0;
+}
+
+void
+tokstream_free(tokstream_t *stream)
+{
+	free(stream->types);
+	free(stream->offsets);
+	free(stream->lengths);
+	free(stream->values);
+	tokstream_init(stream);
+}
+
+int
+tokstream_reserve(tokstream_t *stream, unsigned int capacity)
+{
+	void *next;
+
+	if (capacity <= stream->capacity) {
+		return 1;
+	}
+
+	/* if a later realloc fails, the arrays that already grew are just
+	 * larger than needed, and capacity still describes all of them. */
+	if ((next = realloc(stream->types, sizeof(uint8_t) * capacity))
+	    == NULL) {
+		return 0;
+	}
+	stream->types = next;
+	if ((next = realloc(stream->offsets, sizeof(uint32_t) * capacity))
+	    == NULL) {
+		return 0;
+	}
+	stream->offsets = next;
+	if ((next = realloc(stream->lengths, sizeof(uint32_t) * capacity))
+	    == NULL) {
+		return 0;
+	}
+	stream->lengths = next;
+	if ((next = realloc(stream->values, sizeof(uint32_t) * capacity))
+	    == NULL) {
+		return 0;
+	}
+	stream->values = next;
+
+	stream->capacity = capacity;
+	return 1;
+}
+
+int
+tokstream_push(tokstream_t *stream, token_t token)
+{
+	unsigned int capacity;
+
+	if (stream->len == stream->capacity) {
+		capacity = stream->capacity * 2;
+		if (capacity < TOKSTREAM_MIN_CAPACITY) {
+			capacity = TOKSTREAM_MIN_CAPACITY;
+		}
+		if (!tokstream_reserve(stream, capacity)) {
+			return 0;
+		}
+	}
+
+	stream->types[stream->len] = token.type;
+	stream->offsets[stream->len] = token.offset;
+	stream->lengths[stream->len] = token.length;
+	stream->values[stream->len] = token.value;
+	stream->len++;
+	return 1;
+}
+
+int
+tokstream_append(tokstream_t *stream, tokstream_t *other)
+{
+	unsigned int len = stream->len;
+
+	if (!tokstream_reserve(stream, len + other->len)) {
+		return 0;
+	}
+	memcpy(stream->types + len, other->types, sizeof(uint8_t) * other->len);
+	memcpy(stream->offsets + len,
+	       other->offsets,
+	       sizeof(uint32_t) * other->len);
+	memcpy(stream->lengths + len,
+	       other->lengths,
+	       sizeof(uint32_t) * other->len);
+	memcpy(stream->values + len,
+	       other->values,
+	       sizeof(uint32_t) * other->len);
+	stream->len += other->len;
+	return 1;
+}
+
+token_t
+tokstream_get(tokstream_t *stream, unsigned int pos)
+{
+	token_t token;
+
+	token.type = stream->types[pos];
+	token.offset = stream->offsets[pos];
+	token.length = stream->lengths[pos];
+	token.value = stream->values[pos];
+	return token;
+}
@@ -0,0 +1 @@
+-x * y div 3 mod 4 - a + (b or c) > not not d
@@ -0,0 +1 @@
+prueba { this comment is never closed
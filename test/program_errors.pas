@@ -0,0 +1,23 @@
+program errors(output);
+const
+  a = 1;
+  b = ;
+  c = 'x';
+type
+  t = array [1..] of integer;
+  u = ^integer;
+var
+  x, : integer;
+  y: t;
+procedure p(a: integer; var);
+begin
+  x := 1
+end;
+procedure q(z: char);
+begin
+  writeln(z)
+end;
+begin
+  x := (1 + ;
+  q('a')
+end.
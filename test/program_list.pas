@@ -0,0 +1,16 @@
+program lists(input, output);
+type
+  point = record
+    x, y: integer;
+    tag: char
+  end;
+var
+  p: point;
+procedure show(a, b: integer; var c: char);
+begin
+  writeln(a, b, c)
+end;
+begin
+  p.x := 1;
+  show(p.x, p.y, p.tag)
+end.
@@ -70,6 +70,24 @@ function assert_output() {
 	fi
 }
 
+# Like assert_output, but the input has errors, so it must fail and print
+# them along with the tree parsed around them.
+function assert_errors() {
+	OUTPUT_FILE=$(mktemp)
+	if ! [ -f "$2" ] || ! [ -f "$3" ] ; then
+		echo "[crit] file $2 or $3 not found"
+		EXIT_CODE=1
+	elif ../build/repl -e$1 -r -q < $2 > $OUTPUT_FILE 2>&1 ; then
+		echo "[fail] $1 / $2  expected to fail"
+		EXIT_CODE=1
+	elif ! diff --color -u "$3" "$OUTPUT_FILE" ; then
+		echo "[fail] $1 / $2"
+		EXIT_CODE=1
+	else
+		echo "[ ok ] $1 / $2"
+	fi
+}
+
 function assert_fails() {
 	if ! [ -f "$2" ] ; then
 		echo "[crit] file $2 not found"
@@ -83,10 +101,109 @@ function assert_fails() {
 
 assert_output identifier ident_ok.pas ident_ok.exp
 assert_fails identifier ident_fail.pas
+assert_errors statement statement_errors.pas statement_errors.exp
+assert_errors "statement -c" statement_errors.pas statement_errors.exp
+assert_errors program program_errors.pas program_errors.exp
+assert_errors "program -c" program_errors.pas program_errors.exp
+assert_output identifier ident_comment.pas ident_comment.exp
 assert_output variable variable_normal.pas variable_normal.exp
 assert_output variable variable_idx.pas variable_idx.exp
 assert_output variable variable_dot.pas variable_dot.exp
 assert_output variable variable_caret.pas variable_caret.exp
 assert_output variable variable_complex.pas variable_complex.exp
+assert_output "variable -c" variable_complex.pas variable_complex.exp
+assert_output "variable -k" variable_complex.pas variable_kinds.exp
+assert_output expression expression_assoc.pas expression_assoc.exp
+assert_output statement statement_list.pas statement_list.exp
+assert_output "statement -c" statement_list.pas statement_list.exp
+assert_output program program_list.pas program_list.exp
+assert_output "program -c" program_list.pas program_list.exp
+
+# a huge piece gets a block of its own, the small ones keep theirs.
+if ../build/arenacheck ; then
+	echo "[ ok ] arenacheck"
+else
+	echo "[fail] arenacheck"
+	EXIT_CODE=1
+fi
+
+# every thread must parse the same trees as a single one.
+if ../build/parstress -j 8 -n 20 stress.pas statement_errors.pas \
+	program_errors.pas >/dev/null
+then
+	echo "[ ok ] parstress / stress.pas *_errors.pas"
+else
+	echo "[fail] parstress / stress.pas *_errors.pas"
+	EXIT_CODE=1
+fi
+
+# files are reported in the order they were given, one with errors.
+BATCH_OUTPUT=$(mktemp)
+../build/pasta-batch -j 4 stress.pas program_errors.pas program_list.pas \
+	> $BATCH_OUTPUT 2>/dev/null
+if [[ $? == 1 ]] && diff --color -u batch.exp $BATCH_OUTPUT ; then
+	echo "[ ok ] pasta-batch / batch.exp"
+else
+	echo "[fail] pasta-batch / batch.exp"
+	EXIT_CODE=1
+fi
+
+# a directory that cannot be read is reported, and the rest is parsed.
+BATCH_DIR=$(mktemp -d)
+mkdir $BATCH_DIR/closed
+cp program_list.pas $BATCH_DIR
+chmod 000 $BATCH_DIR/closed
+BATCH_OUTPUT=$(../build/pasta-batch -j 2 $BATCH_DIR 2>/dev/null)
+BATCH_STATUS=$?
+if [ -r $BATCH_DIR/closed ] ; then
+	echo "[skip] pasta-batch / unreadable directory, it can be read"
+elif [[ $BATCH_STATUS == 1 ]] && [[ "$BATCH_OUTPUT" == "\
+$BATCH_DIR/closed: Permission denied
+$BATCH_DIR/program_list.pas: ok" ]] ; then
+	echo "[ ok ] pasta-batch / unreadable directory"
+else
+	echo "[fail] pasta-batch / unreadable directory"
+	EXIT_CODE=1
+fi
+chmod 755 $BATCH_DIR/closed
+rm -r $BATCH_DIR
+
+# links to directories are not followed, so a loop parses each file once.
+BATCH_DIR=$(mktemp -d)
+mkdir $BATCH_DIR/sub
+cp program_list.pas $BATCH_DIR/sub
+ln -s .. $BATCH_DIR/sub/up
+BATCH_OUTPUT=$(../build/pasta-batch -j 2 $BATCH_DIR 2>/dev/null)
+if [[ $? == 0 ]] && [[ "$BATCH_OUTPUT" == \
+	"$BATCH_DIR/sub/program_list.pas: ok" ]] ; then
+	echo "[ ok ] pasta-batch / directory loop"
+else
+	echo "[fail] pasta-batch / directory loop"
+	EXIT_CODE=1
+fi
+rm -r $BATCH_DIR
+
+# expressions nested too deep for the C stack are an error, not a crash.
+DEEP_INPUT=$(mktemp --suffix=.pas)
+awk 'BEGIN {
+	printf "program deep;\nbegin\n  x := ";
+	for (i = 0; i < 50000; i++) printf "(";
+	printf "1";
+	for (i = 0; i < 50000; i++) printf ")";
+	printf ";\n  y := ";
+	for (i = 0; i < 200000; i++) printf "f(";
+	printf "1";
+	for (i = 0; i < 200000; i++) printf ")";
+	printf ";\n  z := 1\nend.\n";
+}' > $DEEP_INPUT
+DEEP_OUTPUT=$(../build/pasta-batch -q $DEEP_INPUT 2>/dev/null)
+if [[ $? == 1 ]] && [[ "$DEEP_OUTPUT" == "\
+$DEEP_INPUT:3:10007: Expressions nested too deeply
+$DEEP_INPUT:4:20007: Expressions nested too deeply" ]] ; then
+	echo "[ ok ] pasta-batch / deep expressions"
+else
+	echo "[fail] pasta-batch / deep expressions"
+	EXIT_CODE=1
+fi
 
 exit $EXIT_CODE
@@ -0,0 +1,6 @@
+begin
+  x := 1 + ;
+  if x then y := (2 else z := 3;
+  repeat a := until b;
+  c := 4
+end
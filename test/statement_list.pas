@@ -0,0 +1,8 @@
+begin
+  x := 1;
+  case x of
+    1, 2: y := f(x, 2);
+    3: begin end
+  end;
+  writeln(x, y)
+end
@@ -0,0 +1,49 @@
+{ license header
+  spanning lines }
+program Sample(input, output);
+(* a trigraph
+   comment with * and ) inside *)
+const
+  Max = 100;
+  Pi = 3.14159;
+  Big = 1.5e10;
+  Small = 2E-3;
+  Greeting = 'Hello, ''world''';
+  Ctrl = #13#10'x';
+type
+  TPoint = record
+    x, y: Integer;
+  end;
+  TArr = array[1..10] of TPoint;
+  PInt = ^Integer;
+var
+  i, j: Integer;
+  p: TPoint;
+  // slash comment
+procedure Foo(var a: Integer; b: Real);
+begin
+  a := a + 1
+end;
+function Bar(x: Integer): Integer;
+begin
+  Bar := x * 2 div 3 mod 4
+end;
+begin
+  for i := 1 to Max do
+  begin
+    if (i <> 3) and (i >= 2) or not (i <= 1) then
+      writeln(i)
+    else
+      Foo(j, 2.0);
+    while i > 0 do i := i - 1;
+    repeat j := j + 1 until j = 10;
+    case i of
+      1, 2: writeln('one or two');
+      3: writeln('three');
+    end;
+    with p do x := 1;
+    p.x := Bar(i)
+  end;
+  goto 10;
+  10: exit(program);
+end.
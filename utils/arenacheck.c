@@ -0,0 +1,105 @@
+/* arenacheck -- checks where the arena places its pieces
+ * Copyright (C) 2024 Dani Rodríguez <dani@danirod.es>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+#define HUGE_PIECE (8 * 1024 * 1024)
+
+static int failures = 0;
+
+static void
+check(int cond, const char *what)
+{
+	if (!cond) {
+		fprintf(stderr, "arenacheck: %s\n", what);
+		failures++;
+	}
+}
+
+static int
+is_zero(const char *data, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		if (data[i]) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/* A huge piece between two small ones leaves the current block alone. */
+static void
+check_small_huge_small(void)
+{
+	arena_t *arena = arena_new();
+	char *first, *huge, *second;
+
+	check(arena != NULL, "out of memory");
+	if (arena == NULL) {
+		return;
+	}
+	first = arena_alloc(arena, 16);
+	huge = arena_alloc(arena, HUGE_PIECE);
+	second = arena_alloc(arena, 16);
+	check(first && huge && second, "out of memory");
+	if (first && huge && second) {
+		check(second == first + 16,
+		      "small piece after a huge one left its block");
+		check(is_zero(huge, HUGE_PIECE), "huge piece is not zeroed");
+		memset(huge, 0xff, HUGE_PIECE);
+		check(is_zero(second, 16), "huge piece overlaps a small one");
+	}
+	check(arena_used(arena) == 16 + HUGE_PIECE + 16,
+	      "wrong number of bytes used");
+	arena_free(arena);
+}
+
+/* A huge piece in an empty arena, and small pieces after it. */
+static void
+check_huge_first(void)
+{
+	arena_t *arena = arena_new();
+	char *huge, *first, *second;
+
+	check(arena != NULL, "out of memory");
+	if (arena == NULL) {
+		return;
+	}
+	huge = arena_alloc(arena, HUGE_PIECE);
+	first = arena_alloc(arena, 1);
+	second = arena_alloc(arena, 1);
+	check(huge && first && second, "out of memory");
+	if (huge && first && second) {
+		check(second == first + 16, "small pieces are not packed");
+		check(first + 16 <= huge || first >= huge + HUGE_PIECE,
+		      "small piece inside the huge one");
+	}
+	arena_free(arena);
+}
+
+int
+main(void)
+{
+	check_small_huge_small();
+	check_huge_first();
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,156 @@
+/* kwbench -- a microbenchmark for keyword recognition
+ * Copyright (C) 2024 Dani Rodríguez <dani@danirod.es>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "token.h"
+
+#define DEFAULT_ROUNDS 200
+
+/*
+ * A sample of identifiers that looks like real Pascal code: a keyword
+ * every few words, mixed case, and plenty of user identifiers that share
+ * a length or a first letter with some keyword.
+ */
+static const char *sample[] = {
+    "begin",    "WriteLn",  "i",       "end",      "Integer", "if",
+    "Then",     "count",    "do",      "Result",   "while",   "idx",
+    "PROCEDURE", "Foo",     "var",     "TPoint",   "of",      "record",
+    "x",        "y",        "to",      "downto",   "for",     "Length",
+    "Array",    "buffer",   "else",    "not",      "nil",     "MaxValue",
+    "repeat",   "until",    "case",    "const",    "type",    "function",
+    "Str",      "s",        "j",       "or",       "and",     "div",
+    "mod",      "Exit",     "readln",  "Counter",  "in",      "with",
+    "set",      "packed",   "file",    "goto",     "program", "Sample",
+};
+
+#define SAMPLE_LEN (sizeof(sample) / sizeof(sample[0]))
+
+/*
+ * The original implementation of match_identifier, kept here as a point of
+ * reference: copy the lexeme, lowercase it and compare it with every entry
+ * of the keyword table.
+ */
+struct keyword {
+	const char *equiv;
+	tokentype_t token;
+};
+
+static struct keyword keywords[] = {
+    {"and", TOK_AND},         {"array", TOK_ARRAY},
+    {"begin", TOK_BEGIN},     {"case", TOK_CASE},
+    {"const", TOK_CONST},     {"div", TOK_DIV},
+    {"do", TOK_DO},           {"downto", TOK_DOWNTO},
+    {"else", TOK_ELSE},       {"end", TOK_END},
+    {"exit", TOK_EXIT},       {"file", TOK_FILE},
+    {"for", TOK_FOR},         {"function", TOK_FUNCTION},
+    {"goto", TOK_GOTO},       {"if", TOK_IF},
+    {"in", TOK_IN},           {"mod", TOK_MOD},
+    {"nil", TOK_NIL},         {"not", TOK_NOT},
+    {"of", TOK_OF},           {"or", TOK_OR},
+    {"packed", TOK_PACKED},   {"procedure", TOK_PROCEDURE},
+    {"program", TOK_PROGRAM}, {"record", TOK_RECORD},
+    {"repeat", TOK_REPEAT},   {"set", TOK_SET},
+    {"then", TOK_THEN},       {"to", TOK_TO},
+    {"type", TOK_TYPE},       {"until", TOK_UNTIL},
+    {"var", TOK_VAR},         {"while", TOK_WHILE},
+    {"with", TOK_WITH},       {0, 0},
+};
+
+static tokentype_t
+legacy_match_identifier(const char *input, unsigned int len)
+{
+	struct keyword *kw;
+	char *lower, *c;
+
+	lower = strndup(input, len);
+	for (c = lower; *c; c++) {
+		if (*c >= 'A' && *c <= 'Z') {
+			*c = (*c) + 0x20;
+		}
+	}
+
+	for (kw = keywords; kw->equiv; kw++) {
+		if (!strcmp(lower, kw->equiv)) {
+			free(lower);
+			return kw->token;
+		}
+	}
+
+	free(lower);
+	return TOK_IDENTIFIER;
+}
+
+static double
+now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double
+run(tokentype_t (*matcher)(const char *, unsigned int),
+    unsigned int *lens,
+    unsigned long rounds,
+    unsigned long *checksum)
+{
+	unsigned long r, i;
+	double start = now();
+
+	for (r = 0; r < rounds; r++) {
+		for (i = 0; i < SAMPLE_LEN; i++) {
+			*checksum += matcher(sample[i], lens[i]);
+		}
+	}
+	return now() - start;
+}
+
+int
+main(int argc, char **argv)
+{
+	unsigned int lens[SAMPLE_LEN];
+	unsigned long rounds = DEFAULT_ROUNDS * 1000, i;
+	unsigned long legacy_sum = 0, current_sum = 0;
+	double legacy_time, current_time, total;
+
+	if (argc > 1) {
+		rounds = strtoul(argv[1], NULL, 10) * 1000;
+	}
+
+	/* both implementations must agree before timing anything */
+	for (i = 0; i < SAMPLE_LEN; i++) {
+		lens[i] = strlen(sample[i]);
+		if (match_identifier(sample[i], lens[i])
+		    != legacy_match_identifier(sample[i], lens[i])) {
+			fprintf(stderr, "mismatch for %s\n", sample[i]);
+			return 1;
+		}
+	}
+
+	total = (double) rounds * SAMPLE_LEN;
+	legacy_time = run(legacy_match_identifier, lens, rounds, &legacy_sum);
+	current_time = run(match_identifier, lens, rounds, &current_sum);
+
+	printf("identifiers: %.0f\n", total);
+	printf("before: %10.2f Mident/s\n", total / legacy_time / 1e6);
+	printf("after:  %10.2f Mident/s\n", total / current_time / 1e6);
+	printf("speedup: %.2fx\n", legacy_time / current_time);
+	return legacy_sum != current_sum;
+}
@@ -0,0 +1,256 @@
+/* parstress -- parses the same files from many threads at once
+ * Copyright (C) 2024 Dani Rodríguez <dani@danirod.es>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ast.h"
+#include "parser.h"
+#include "scanner.h"
+
+#define DEFAULT_THREADS 8
+#define DEFAULT_ROUNDS 50
+
+/* An input file, along with what parsing it on a single thread gave. */
+struct input {
+	const char *path;
+	char *data;
+	size_t len;
+	char *expected;
+	size_t expected_len;
+};
+
+struct worker {
+	pthread_t thread;
+	unsigned int id;
+	struct input *inputs;
+	unsigned int inputs_len;
+	unsigned long rounds;
+	unsigned long parses;
+	unsigned long mismatches;
+};
+
+static char *
+readall(const char *path, size_t *len)
+{
+	char *data;
+	int fd;
+
+	if ((fd = open(path, O_RDONLY)) == -1) {
+		return NULL;
+	}
+	data = scanner_read_all(fd, len);
+	close(fd);
+	return data;
+}
+
+static void
+print_diagnostics(FILE *out, parse_result_t *result)
+{
+	unsigned int i;
+	diagnostic_t *diagnostic;
+
+	for (i = 0; i < result->diagnostics_len; i++) {
+		diagnostic = &result->diagnostics[i];
+		fprintf(out,
+		        "%u:%u: %s\n",
+		        diagnostic->line,
+		        diagnostic->col,
+		        diagnostic->message);
+	}
+}
+
+/*
+ * Parses the input as a program with a scanner, parser and tables of its
+ * own, and prints everything that was found into a string: the number of
+ * tokens, the errors and the tree in both of its forms. Returns NULL if
+ * out of memory.
+ */
+static char *
+parse(struct input *input, size_t *len)
+{
+	scanner_t *scanner;
+	symtab_t *symtab;
+	strarena_t *strings;
+	parser_t *parser;
+	parse_result_t *result = NULL;
+	ast_t ast;
+	char *dump = NULL;
+	FILE *out;
+
+	symtab = symtab_new();
+	strings = strarena_new();
+	scanner = scanner_init(input->data, input->len);
+	parser = parser_new();
+	if (symtab == NULL || strings == NULL || scanner == NULL
+	    || parser == NULL) {
+		goto done;
+	}
+	scanner_set_symtab(scanner, symtab);
+	scanner_set_strarena(scanner, strings);
+	if (!parser_load_tokens(parser, scanner)
+	    || (result = parser_parse(parser, parser_program)) == NULL
+	    || (out = open_memstream(&dump, len)) == NULL) {
+		goto done;
+	}
+
+	fprintf(out, "tokens: %u\n", parser->tokens.len);
+	print_diagnostics(out, result);
+	dump_expr(parser, out, result->root);
+	if (ast_init(&ast)) {
+		ast_dump(&ast, scanner, out, ast_from_expr(&ast, result->root));
+		ast_free(&ast);
+	}
+	if (fclose(out) == EOF) {
+		free(dump);
+		dump = NULL;
+	}
+
+done:
+	if (result) {
+		parse_result_free(result);
+	}
+	if (parser) {
+		parser_free(parser);
+	}
+	if (scanner) {
+		scanner_free(scanner);
+	}
+	if (strings) {
+		strarena_free(strings);
+	}
+	if (symtab) {
+		symtab_free(symtab);
+	}
+	return dump;
+}
+
+static void *
+work(void *arg)
+{
+	struct worker *worker = arg;
+	struct input *input;
+	unsigned long round;
+	unsigned int i;
+	size_t len;
+	char *dump;
+
+	for (round = 0; round < worker->rounds; round++) {
+		for (i = 0; i < worker->inputs_len; i++) {
+			/* start at a different file on every thread. */
+			input = &worker->inputs[(i + worker->id)
+			                        % worker->inputs_len];
+			dump = parse(input, &len);
+			if (dump == NULL || len != input->expected_len
+			    || memcmp(dump, input->expected, len)) {
+				worker->mismatches++;
+			}
+			worker->parses++;
+			free(dump);
+		}
+	}
+	return NULL;
+}
+
+static void
+usage()
+{
+	fprintf(stderr, "Usage: parstress [-j threads] [-n rounds] file...\n");
+	exit(1);
+}
+
+int
+main(int argc, char **argv)
+{
+	unsigned long threads = DEFAULT_THREADS, rounds = DEFAULT_ROUNDS;
+	unsigned long parses = 0, mismatches = 0;
+	struct input *inputs;
+	struct worker *workers;
+	unsigned int inputs_len, i;
+	int c;
+
+	while ((c = getopt(argc, argv, "j:n:")) != -1) {
+		switch (c) {
+		case 'j':
+			threads = strtoul(optarg, NULL, 10);
+			break;
+		case 'n':
+			rounds = strtoul(optarg, NULL, 10);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind >= argc || threads == 0) {
+		usage();
+	}
+
+	inputs_len = argc - optind;
+	inputs = calloc(inputs_len, sizeof(struct input));
+	workers = calloc(threads, sizeof(struct worker));
+	if (inputs == NULL || workers == NULL) {
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+
+	/* the reference output of every file, parsed before any thread. */
+	for (i = 0; i < inputs_len; i++) {
+		inputs[i].path = argv[optind + i];
+		inputs[i].data = readall(inputs[i].path, &inputs[i].len);
+		if (inputs[i].data == NULL) {
+			perror(inputs[i].path);
+			return 1;
+		}
+		inputs[i].expected = parse(&inputs[i], &inputs[i].expected_len);
+		if (inputs[i].expected == NULL) {
+			fprintf(stderr, "cannot parse %s\n", inputs[i].path);
+			return 1;
+		}
+	}
+
+	for (i = 0; i < threads; i++) {
+		workers[i].id = i;
+		workers[i].inputs = inputs;
+		workers[i].inputs_len = inputs_len;
+		workers[i].rounds = rounds;
+		if (pthread_create(
+		        &workers[i].thread, NULL, work, &workers[i])) {
+			fprintf(stderr, "cannot create thread\n");
+			return 1;
+		}
+	}
+	for (i = 0; i < threads; i++) {
+		pthread_join(workers[i].thread, NULL);
+		parses += workers[i].parses;
+		mismatches += workers[i].mismatches;
+	}
+
+	printf("threads: %lu, parses: %lu, mismatches: %lu\n",
+	       threads,
+	       parses,
+	       mismatches);
+	for (i = 0; i < inputs_len; i++) {
+		free(inputs[i].data);
+		free(inputs[i].expected);
+	}
+	free(inputs);
+	free(workers);
+	return mismatches != 0;
+}
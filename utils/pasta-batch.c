@@ -0,0 +1,467 @@
+/* pasta-batch -- parses many Pascal files at once
+ * Copyright (C) 2024 Dani Rodríguez <dani@danirod.es>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "parser.h"
+#include "scanner.h"
+
+#define STATUS_OK 0
+#define STATUS_ERRORS 1
+#define STATUS_FAILED 2
+
+/* A file to parse, and what was found in it once it has been parsed. */
+struct job {
+	char *path;
+	int status;
+	int error; /* errno, when it could not be parsed at all. */
+	char *report; /* errors, one per line, or NULL if there are none. */
+	size_t report_len;
+	size_t bytes;
+	unsigned long tokens;
+};
+
+struct pool;
+
+/*
+ * Every worker owns the jobs from top to bottom. It takes them from the
+ * top, one at a time, and once it runs out of them it steals the bottom
+ * half of the jobs that another worker has left. Jobs are never added,
+ * so the jobs of a worker are always a range of the array.
+ */
+struct worker {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	unsigned int id;
+	unsigned int top, bottom;
+	struct pool *pool;
+};
+
+struct pool {
+	struct job *jobs;
+	unsigned int jobs_len, jobs_cap;
+	struct worker *workers;
+	unsigned int workers_len;
+};
+
+static double
+now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+outofmemory()
+{
+	fprintf(stderr, "pasta-batch: out of memory\n");
+	exit(1);
+}
+
+static struct job *
+add_job(struct pool *pool, const char *path)
+{
+	struct job *jobs;
+	unsigned int cap;
+
+	if (pool->jobs_len == pool->jobs_cap) {
+		cap = pool->jobs_cap ? pool->jobs_cap * 2 : 64;
+		if ((jobs = realloc(pool->jobs, cap * sizeof(struct job)))
+		    == NULL) {
+			outofmemory();
+		}
+		pool->jobs = jobs;
+		pool->jobs_cap = cap;
+	}
+	memset(&pool->jobs[pool->jobs_len], 0, sizeof(struct job));
+	if ((pool->jobs[pool->jobs_len].path = strdup(path)) == NULL) {
+		outofmemory();
+	}
+	return &pool->jobs[pool->jobs_len++];
+}
+
+static int
+is_source(const char *name)
+{
+	size_t len = strlen(name);
+
+	return len > 4 && !strcasecmp(name + len - 4, ".pas");
+}
+
+/* Adds every source file under the directory, in alphabetical order, so
+ * that the output does not depend on the order of the entries on disk. A
+ * directory that cannot be read is reported as a job that failed. Links to
+ * directories are not followed, since they may lead back up the tree. */
+static void
+add_directory(struct pool *pool, const char *dir)
+{
+	struct dirent **names;
+	struct stat st;
+	struct job *job;
+	char *path;
+	int len, i;
+
+	if ((len = scandir(dir, &names, NULL, alphasort)) == -1) {
+		job = add_job(pool, dir);
+		job->status = STATUS_FAILED;
+		job->error = errno;
+		return;
+	}
+	for (i = 0; i < len; i++) {
+		if (names[i]->d_name[0] == '.') {
+			free(names[i]);
+			continue;
+		}
+		if ((path = malloc(strlen(dir) + strlen(names[i]->d_name) + 2))
+		    == NULL) {
+			outofmemory();
+		}
+		sprintf(path, "%s/%s", dir, names[i]->d_name);
+		if (lstat(path, &st) == 0 && S_ISDIR(st.st_mode)) {
+			add_directory(pool, path);
+		} else if (is_source(names[i]->d_name)) {
+			add_job(pool, path);
+		}
+		free(path);
+		free(names[i]);
+	}
+	free(names);
+}
+
+static void
+add_path(struct pool *pool, const char *path)
+{
+	struct stat st;
+
+	if (stat(path, &st) == 0 && S_ISDIR(st.st_mode)) {
+		add_directory(pool, path);
+	} else {
+		/* files that cannot be read are reported along the rest. */
+		add_job(pool, path);
+	}
+}
+
+/* Adds the paths in the file, one per line, or in stdin for "-". */
+static void
+add_list(struct pool *pool, const char *list)
+{
+	char *line = NULL;
+	size_t linecap = 0;
+	ssize_t linelen;
+	FILE *fp = stdin;
+
+	if (strcmp(list, "-") && (fp = fopen(list, "r")) == NULL) {
+		perror(list);
+		exit(1);
+	}
+	while ((linelen = getline(&line, &linecap, fp)) != -1) {
+		while (linelen > 0
+		       && (line[linelen - 1] == '\n'
+		           || line[linelen - 1] == '\r')) {
+			line[--linelen] = 0;
+		}
+		if (linelen > 0) {
+			add_path(pool, line);
+		}
+	}
+	free(line);
+	if (fp != stdin) {
+		fclose(fp);
+	}
+}
+
+static void
+report_diagnostics(struct job *job, parse_result_t *result)
+{
+	diagnostic_t *diagnostic;
+	unsigned int i;
+	FILE *out;
+
+	if ((out = open_memstream(&job->report, &job->report_len)) == NULL) {
+		job->status = STATUS_FAILED;
+		return;
+	}
+	for (i = 0; i < result->diagnostics_len; i++) {
+		diagnostic = &result->diagnostics[i];
+		fprintf(out,
+		        "%s:%u:%u: %s\n",
+		        job->path,
+		        diagnostic->line,
+		        diagnostic->col,
+		        diagnostic->message);
+	}
+	if (fclose(out) == EOF) {
+		job->status = STATUS_FAILED;
+	}
+}
+
+/* Parses the file of the job with a scanner and a parser of its own. */
+static void
+run_job(struct job *job)
+{
+	scanner_t *scanner;
+	parser_t *parser;
+	parse_result_t *result;
+	int fd;
+
+	/* it failed before it was run, see add_directory. */
+	if (job->error) {
+		return;
+	}
+	job->status = STATUS_FAILED;
+	if ((fd = open(job->path, O_RDONLY)) == -1) {
+		job->error = errno;
+		return;
+	}
+	if ((scanner = scanner_init_mapped(fd)) == NULL
+	    && (scanner = scanner_init_read(fd)) == NULL) {
+		job->error = errno;
+		close(fd);
+		return;
+	}
+	close(fd);
+	job->error = ENOMEM;
+	if ((parser = parser_new()) == NULL) {
+		scanner_free(scanner);
+		return;
+	}
+
+	if (parser_load_tokens(parser, scanner)
+	    && (result = parser_parse(parser, parser_program)) != NULL) {
+		job->bytes = scanner_length(scanner);
+		job->tokens = parser->tokens.len;
+		if (result->diagnostics_len == 0) {
+			job->status = STATUS_OK;
+		} else {
+			job->status = STATUS_ERRORS;
+			report_diagnostics(job, result);
+		}
+		parse_result_free(result);
+	}
+	parser_free(parser);
+	scanner_free(scanner);
+}
+
+/*
+ * Takes the next job of the worker, or else steals some from another one.
+ * Returns 0 once there are no jobs left anywhere. A worker never holds two
+ * locks, so two of them stealing from each other cannot deadlock; while
+ * it steals, its own range is empty and nobody else touches it.
+ */
+static int
+next_job(struct worker *worker, unsigned int *job)
+{
+	struct pool *pool = worker->pool;
+	struct worker *victim;
+	unsigned int i, mid, bottom;
+
+	pthread_mutex_lock(&worker->lock);
+	if (worker->top < worker->bottom) {
+		*job = worker->top++;
+		pthread_mutex_unlock(&worker->lock);
+		return 1;
+	}
+	pthread_mutex_unlock(&worker->lock);
+
+	for (i = 1; i < pool->workers_len; i++) {
+		victim = &pool->workers[(worker->id + i) % pool->workers_len];
+		pthread_mutex_lock(&victim->lock);
+		if (victim->top < victim->bottom) {
+			/* run one of the stolen jobs and keep the rest. */
+			mid = victim->top + (victim->bottom - victim->top) / 2;
+			bottom = victim->bottom;
+			victim->bottom = mid;
+			pthread_mutex_unlock(&victim->lock);
+
+			*job = mid;
+			pthread_mutex_lock(&worker->lock);
+			worker->top = mid + 1;
+			worker->bottom = bottom;
+			pthread_mutex_unlock(&worker->lock);
+			return 1;
+		}
+		pthread_mutex_unlock(&victim->lock);
+	}
+	return 0;
+}
+
+static void *
+work(void *arg)
+{
+	struct worker *worker = arg;
+	unsigned int job;
+
+	while (next_job(worker, &job)) {
+		run_job(&worker->pool->jobs[job]);
+	}
+	return NULL;
+}
+
+/*
+ * Splits the jobs among the workers and waits for all of them. The calling
+ * thread is the first worker. The jobs of a thread that cannot be started
+ * are not lost, since the other workers end up stealing them.
+ */
+static void
+run_pool(struct pool *pool, unsigned int threads)
+{
+	unsigned int i, step;
+	int *started;
+
+	pool->workers = calloc(threads, sizeof(struct worker));
+	started = calloc(threads, sizeof(int));
+	if (pool->workers == NULL || started == NULL) {
+		outofmemory();
+	}
+	pool->workers_len = threads;
+	step = pool->jobs_len / threads;
+	for (i = 0; i < threads; i++) {
+		pthread_mutex_init(&pool->workers[i].lock, NULL);
+		pool->workers[i].id = i;
+		pool->workers[i].pool = pool;
+		pool->workers[i].top = step * i;
+		pool->workers[i].bottom =
+		    i + 1 < threads ? step * (i + 1) : pool->jobs_len;
+	}
+
+	for (i = 1; i < threads; i++) {
+		started[i] = !pthread_create(&pool->workers[i].thread,
+		                             NULL,
+		                             work,
+		                             &pool->workers[i]);
+	}
+	work(&pool->workers[0]);
+	for (i = 1; i < threads; i++) {
+		if (started[i]) {
+			pthread_join(pool->workers[i].thread, NULL);
+		}
+	}
+
+	for (i = 0; i < threads; i++) {
+		pthread_mutex_destroy(&pool->workers[i].lock);
+	}
+	free(pool->workers);
+	free(started);
+}
+
+static void
+usage()
+{
+	fprintf(stderr,
+	        "Usage: pasta-batch [-q] [-j threads] [-l list] [path...]\n");
+	fprintf(stderr, " -q: only print the files that have errors\n");
+	fprintf(stderr, " -j: number of threads, by default one per CPU\n");
+	fprintf(stderr, " -l: parse the paths in the file, one per line\n");
+	fprintf(stderr, "Directories are searched for .pas files.\n");
+	exit(1);
+}
+
+int
+main(int argc, char **argv)
+{
+	struct pool pool = {NULL, 0, 0, NULL, 0};
+	struct job *job;
+	unsigned long threads = 0, tokens = 0;
+	unsigned int i, errors = 0;
+	double start, elapsed, bytes = 0;
+	int quiet = 0, given = 0, c;
+	long cpus;
+
+	while ((c = getopt(argc, argv, "qj:l:")) != -1) {
+		switch (c) {
+		case 'q':
+			quiet = 1;
+			break;
+		case 'j':
+			threads = strtoul(optarg, NULL, 10);
+			break;
+		case 'l':
+			add_list(&pool, optarg);
+			given = 1;
+			break;
+		default:
+			usage();
+		}
+	}
+	for (; optind < argc; optind++) {
+		add_path(&pool, argv[optind]);
+		given = 1;
+	}
+	if (!given) {
+		usage();
+	}
+	if (threads == 0) {
+		cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = cpus > 0 ? cpus : 1;
+	}
+	if (threads > pool.jobs_len) {
+		threads = pool.jobs_len ? pool.jobs_len : 1;
+	}
+
+	start = now();
+	run_pool(&pool, threads);
+	elapsed = now() - start;
+
+	/* in the order the files were given, whichever thread parsed them. */
+	for (i = 0; i < pool.jobs_len; i++) {
+		job = &pool.jobs[i];
+		bytes += job->bytes;
+		tokens += job->tokens;
+		switch (job->status) {
+		case STATUS_OK:
+			if (!quiet) {
+				printf("%s: ok\n", job->path);
+			}
+			break;
+		case STATUS_ERRORS:
+			errors++;
+			fwrite(job->report, 1, job->report_len, stdout);
+			break;
+		default:
+			errors++;
+			printf("%s: %s\n", job->path, strerror(job->error));
+			break;
+		}
+		free(job->report);
+		free(job->path);
+	}
+	free(pool.jobs);
+	fflush(stdout);
+
+	fprintf(stderr,
+	        "files: %u, with errors: %u, threads: %lu, time: %.3f s\n",
+	        pool.jobs_len,
+	        errors,
+	        threads,
+	        elapsed);
+	fprintf(stderr,
+	        "%.2f files/s, %.2f MB/s, %.2f Mtok/s\n",
+	        pool.jobs_len / elapsed,
+	        bytes / elapsed / 1e6,
+	        tokens / elapsed / 1e6);
+	return errors != 0;
+}
@@ -14,17 +14,18 @@
  * You should have received a copy of the GNU General Public License
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
+#include "ast.h"
 #include "parser.h"
 #include "scanner.h"
 #include "token.h"
 
-#define BUFFER_SIZE 65536
-#define FGETS_SIZE 80
+#define READ_SIZE 65536
 
 #define DEFAULT_EXPRESSION_NODE "statement"
 
@@ -34,7 +35,7 @@ struct expfunc_type {
 	const char *desc;
 };
 
-static struct expfunc_type expfunc_list[] = {
+static const struct expfunc_type expfunc_list[] = {
     {"identifier", parser_identifier, "Identifiers"},
     {"unsigned_integer", parser_unsigned_integer, "Unsigned integers"},
     {"unsigned_number", parser_unsigned_number, "Unsigned numbers"},
@@ -59,15 +60,22 @@ static struct expfunc_type expfunc_list[] = {
 #define MODE_TOKENS 1
 #define MODE_EXPRS 2
 
-static int func_mode = MODE_UNKNOWN;
-static char *func_expr_type = NULL;
-static expr_t *(*func_expr_cb)(parser_t *);
-static int func_quiet = 0;
+/* What to do with the input, as given by the flags. */
+struct options {
+	int mode;
+	char *expr_type;
+	expr_t *(*expr_cb)(parser_t *);
+	int quiet;
+	int stream;
+	int compact;
+	int kinds;
+	int recovered;
+};
 
-static struct expfunc_type *
+static const struct expfunc_type *
 get_desired_expfunc(char *type)
 {
-	struct expfunc_type *expr = expfunc_list;
+	const struct expfunc_type *expr = expfunc_list;
 	while (expr->type != 0) {
 		if (!strcmp(type, expr->type)) {
 			return expr;
@@ -77,49 +85,81 @@ get_desired_expfunc(char *type)
 	return NULL;
 }
 
-static char buffer[BUFFER_SIZE];
+/*
+ * Input typed at the keyboard is read into a buffer, which grows as
+ * needed and always has room for the padding that the scanner expects
+ * after the input.
+ */
+struct buffer {
+	char *data;
+	size_t len;
+	size_t cap;
+};
 
 static void
-print_token(token_t *tok)
+buffer_reserve(struct buffer *buffer, size_t len)
 {
-	if (tok->meta != 0) {
-		printf("%s(%s) <%d,%d>\n",
-		       tokentype_string(tok->type),
-		       tok->meta,
-		       tok->line,
-		       tok->col);
-	} else {
-		printf("%s <%d,%d>\n",
-		       tokentype_string(tok->type),
-		       tok->line,
-		       tok->col);
+	size_t cap = buffer->cap ? buffer->cap : READ_SIZE;
+	char *data;
+
+	while (cap < buffer->len + len + SCANNER_PADDING) {
+		cap *= 2;
+	}
+	if (cap != buffer->cap) {
+		if ((data = realloc(buffer->data, cap)) == NULL) {
+			perror("cannot read input");
+			exit(1);
+		}
+		buffer->data = data;
+		buffer->cap = cap;
 	}
 }
 
 static void
-readfile()
+buffer_append(struct buffer *buffer, const char *data, size_t len)
 {
-	int offt = 0;
-	char partial_buffer[FGETS_SIZE];
+	buffer_reserve(buffer, len);
+	memcpy(buffer->data + buffer->len, data, len);
+	buffer->len += len;
+}
 
-	while (fgets(partial_buffer, FGETS_SIZE, stdin) != NULL) {
-		// append whatever we have read into the buffer
-		strncpy(buffer + offt, partial_buffer, FGETS_SIZE);
-		offt += strnlen(partial_buffer, FGETS_SIZE);
+static scanner_t *
+buffer_scanner(struct buffer *buffer)
+{
+	buffer_reserve(buffer, 0);
+	memset(buffer->data + buffer->len, 0, SCANNER_PADDING);
+	return scanner_init_padded(buffer->data, buffer->len);
+}
+
+static void
+print_token(scanner_t *scanner, token_t *tok)
+{
+	unsigned int line = 0, col = 0;
+
+	scanner_position(scanner, tok->offset, &line, &col);
+	if (tok->length != 0) {
+		printf("%s(%.*s) <%d,%d>\n",
+		       tokentype_string(tok->type),
+		       (int) tok->length,
+		       scanner_lexeme(scanner, tok),
+		       line,
+		       col);
+	} else {
+		printf("%s <%d,%d>\n", tokentype_string(tok->type), line, col);
 	}
 }
 
 static int
-readkeyb()
+readkeyb(struct buffer *buffer)
 {
-	int offt = 0;
-	char partial_buffer[FGETS_SIZE];
+	char *line = NULL;
+	size_t linecap = 0;
+	ssize_t linelen;
 
-	// mark the start of the string with a zero to detect empty string
-	buffer[0] = 0;
+	buffer->len = 0;
 
-	while (fgets(partial_buffer, FGETS_SIZE, stdin) != NULL) {
-		char *pbuf_start = partial_buffer;
+	while ((linelen = getline(&line, &linecap, stdin)) != -1) {
+		char *pbuf_start = line;
 
 		// skip whitespace at the beginning of the read line and treat
 		// empty strings as if no characters had been read
@@ -131,30 +171,50 @@ readkeyb()
 		}
 
 		// append whatever we have read into the buffer
-		strncpy(buffer + offt, pbuf_start, FGETS_SIZE);
-		offt += strnlen(pbuf_start, FGETS_SIZE);
+		buffer_append(buffer,
+		              pbuf_start,
+		              linelen - (pbuf_start - line));
 	}
-	return offt;
+	free(line);
+	return buffer->len;
 }
 
-static int
-evaltoken()
+/* Scans the file at path, or the standard input if path is NULL. Files
+ * are mapped when possible, and only read otherwise. */
+static scanner_t *
+openinput(const char *path)
 {
 	scanner_t *scanner;
-	token_t *token;
+	int fd = 0;
+
+	if (path && (fd = open(path, O_RDONLY)) == -1) {
+		perror(path);
+		exit(1);
+	}
+	if ((scanner = scanner_init_mapped(fd)) == NULL
+	    && (scanner = scanner_init_read(fd)) == NULL) {
+		perror("cannot read input");
+		exit(1);
+	}
+	if (path) {
+		close(fd);
+	}
+	return scanner;
+}
+
+static int
+evaltoken(scanner_t *scanner)
+{
+	token_t token;
 	int eof = 0;
-	int length = strnlen((const char *) buffer, BUFFER_SIZE);
 
-	if ((scanner = scanner_init(buffer, length)) != NULL) {
+	if (scanner != NULL) {
 		do {
 			token = scanner_next(scanner);
-			if (token)
-				print_token(token);
-			if (token->type == TOK_EOF) {
+			print_token(scanner, &token);
+			if (token.type == TOK_EOF) {
 				eof = 1;
 			}
-			token_free(token);
-			free(token);
 		} while (!eof);
 
 		scanner_free(scanner);
@@ -163,64 +223,143 @@ evaltoken()
 	return -1;
 }
 
+/* Dumps the tree after converting it to its compact form. */
+static void
+dumpcompact(scanner_t *scanner, expr_t *root)
+{
+	ast_t ast;
+	ast_index_t index;
+
+	if (!ast_init(&ast)) {
+		fprintf(stderr, "Out of memory converting the tree\n");
+		return;
+	}
+	if ((index = ast_from_expr(&ast, root)) == AST_NONE && root) {
+		fprintf(stderr, "Out of memory converting the tree\n");
+	}
+	ast_dump(&ast, scanner, stdout, index);
+	ast_free(&ast);
+}
+
+static void
+dumptree(const struct options *options,
+         parser_t *parser,
+         scanner_t *scanner,
+         expr_t *root)
+{
+	if (options->compact) {
+		dumpcompact(scanner, root);
+	} else if (options->kinds) {
+		dump_expr_kinds(parser, stdout, root);
+	} else {
+		dump_expr(parser, stdout, root);
+	}
+}
+
+static void
+print_diagnostic(scanner_t *scanner, diagnostic_t *diagnostic)
+{
+	token_t *tok = &diagnostic->token;
+
+	printf("Error: %s. ", diagnostic->message);
+	if (tok->length != 0) {
+		printf("%s(%.*s)\n",
+		       tokentype_string(tok->type),
+		       (int) tok->length,
+		       scanner_lexeme(scanner, tok));
+	} else {
+		puts(tokentype_string(tok->type));
+	}
+	printf("\n Line: %d, Col: %d\n", diagnostic->line, diagnostic->col);
+}
+
+static void
+print_diagnostics(scanner_t *scanner, parse_result_t *result)
+{
+	unsigned int i;
+
+	for (i = 0; i < result->diagnostics_len; i++) {
+		print_diagnostic(scanner, &result->diagnostics[i]);
+	}
+}
+
+/* Prints the tree, or else every error found in the input, followed by the
+ * tree parsed around them if asked to. */
 static int
-evalexpr()
+evalexpr(const struct options *options, scanner_t *scanner)
 {
-	scanner_t *scanner;
 	parser_t *parser;
-	token_t *token;
-	int eof = 0;
-	int length = strnlen((const char *) buffer, BUFFER_SIZE);
+	parse_result_t *result;
+	int status = 0;
 
-	if ((scanner = scanner_init(buffer, length)) != NULL) {
+	if (scanner != NULL) {
 		parser = parser_new();
-		parser_load_tokens(parser, scanner);
-		dump_expr(func_expr_cb(parser));
+		if (options->stream) {
+			parser_stream_tokens(parser, scanner);
+		} else if (!parser_load_tokens(parser, scanner)) {
+			fprintf(stderr, "Out of memory loading tokens\n");
+			parser_free(parser);
+			scanner_free(scanner);
+			return -1;
+		}
+		if ((result = parser_parse(parser, options->expr_cb)) == NULL) {
+			fprintf(stderr, "Out of memory parsing\n");
+			parser_free(parser);
+			scanner_free(scanner);
+			return -1;
+		}
+		if (result->diagnostics_len > 0) {
+			print_diagnostics(scanner, result);
+			status = -1;
+		}
+		if (status == 0 || options->recovered) {
+			dumptree(options, parser, scanner, result->root);
+		}
+		parser_free(parser);
+		parse_result_free(result);
 		scanner_free(scanner);
-		return 0;
+		return status;
 	}
 	return -1;
 }
 
 static int
-readtokenloop()
+readtokenloop(struct buffer *buffer)
 {
 	printf("> ");
-	if (readkeyb() == 0) {
+	if (readkeyb(buffer) == 0) {
 		return 1;
 	}
 
-	evaltoken();
+	evaltoken(buffer_scanner(buffer));
 
 	return 0;
 }
 
 static void
-readtokenstr()
+readtokenstr(const char *path)
 {
-	readfile();
-	evaltoken();
+	evaltoken(openinput(path));
 }
 
 static int
-readexprloop()
+readexprloop(const struct options *options, struct buffer *buffer)
 {
 	if (isatty(0))
 		printf("> ");
-	if (readkeyb() == 0) {
+	if (readkeyb(buffer) == 0) {
 		return 1;
 	}
 
-	evalexpr();
+	evalexpr(options, buffer_scanner(buffer));
 
 	return 0;
 }
 
-static void
-readexprstr()
+static int
+readexprstr(const struct options *options, const char *path)
 {
-	readfile();
-	evalexpr();
+	return evalexpr(options, openinput(path));
 }
 
 void
@@ -229,57 +368,82 @@ usage()
 	puts("Flags:");
 	puts(" -t: read in tokens mode");
 	puts(" -e=<node>: read in expressions mode of type <node>");
+	puts(" -s: scan tokens as the parser needs them, not all upfront");
+	puts(" -c: print the tree from its compact form");
+	puts(" -k: print what every node was parsed from");
+	puts(" -r: print the tree parsed around errors too");
+	puts("The code is read from the given file, or else from stdin.");
 }
 
 void
-dotokens()
+dotokens(struct buffer *buffer, const char *path)
 {
-	if (isatty(0)) {
-		while (!readtokenloop())
+	if (!path && isatty(0)) {
+		while (!readtokenloop(buffer))
 			;
 	} else {
-		readtokenstr();
+		readtokenstr(path);
 	}
 }
 
-void
-doexpressions()
+int
+doexpressions(const struct options *options,
+              struct buffer *buffer,
+              const char *path)
 {
-	if (isatty(0)) {
-		while (!readexprloop())
+	if (!path && isatty(0)) {
+		while (!readexprloop(options, buffer))
 			;
+		return 0;
 	} else {
-		readexprstr();
+		return readexprstr(options, path);
 	}
 }
 
 int
 main(int argc, char **argv)
 {
+	struct options options = {MODE_UNKNOWN, NULL, NULL, 0, 0, 0, 0, 0};
+	struct buffer buffer = {NULL, 0, 0};
+	const struct expfunc_type *type;
+	const char *path = NULL;
+	int status = 0;
 	int c;
 
-	while ((c = getopt(argc, argv, "te::hq")) != -1) {
+	while ((c = getopt(argc, argv, "te::hqsckr")) != -1) {
 		switch (c) {
 		case 't':
-			if (func_mode != MODE_UNKNOWN) {
+			if (options.mode != MODE_UNKNOWN) {
 				puts("Provide a single -t or -e");
 				return 1;
 			}
-			func_mode = MODE_TOKENS;
+			options.mode = MODE_TOKENS;
 			break;
 		case 'e':
-			if (func_mode != MODE_UNKNOWN) {
+			if (options.mode != MODE_UNKNOWN) {
 				puts("Provide a single -t or -e");
 				return 1;
 			}
-			func_mode = MODE_EXPRS;
-			func_expr_type = optarg;
+			options.mode = MODE_EXPRS;
+			options.expr_type = optarg;
 			break;
 		case 'h':
 			usage();
 			break;
 		case 'q':
-			func_quiet = 1;
+			options.quiet = 1;
+			break;
+		case 's':
+			options.stream = 1;
+			break;
+		case 'c':
+			options.compact = 1;
+			break;
+		case 'k':
+			options.kinds = 1;
+			break;
+		case 'r':
+			options.recovered = 1;
 			break;
 		case '?':
 			printf("tenemos un problema. c = %d\n", c);
@@ -288,22 +452,26 @@ main(int argc, char **argv)
 		}
 	}
 
-	if (func_mode == MODE_UNKNOWN) {
+	if (optind < argc) {
+		path = argv[optind];
+	}
+
+	if (options.mode == MODE_UNKNOWN) {
 		usage();
-	} else if (func_mode == MODE_TOKENS) {
-		dotokens();
-	} else if (func_mode == MODE_EXPRS) {
-		if (func_expr_type == NULL) {
-			func_expr_type = DEFAULT_EXPRESSION_NODE;
+	} else if (options.mode == MODE_TOKENS) {
+		dotokens(&buffer, path);
+	} else if (options.mode == MODE_EXPRS) {
+		if (options.expr_type == NULL) {
+			options.expr_type = DEFAULT_EXPRESSION_NODE;
 		}
-		struct expfunc_type *type = get_desired_expfunc(func_expr_type);
+		type = get_desired_expfunc(options.expr_type);
 		if (type == NULL) {
-			printf("Unrecognised type: %s\n", func_expr_type);
+			printf("Unrecognised type: %s\n", options.expr_type);
 			return 1;
 		}
-		func_expr_cb = type->callback;
+		options.expr_cb = type->callback;
 
-		if (!func_quiet) {
+		if (!options.quiet) {
 			puts("Entering expression mode. Type Pascal code to be "
 			     "evaluated.\n"
 			     "End your expression with an empty line to submit "
@@ -311,6 +479,10 @@ main(int argc, char **argv)
 			     "parser.");
 			printf("Expression mode: %s\n", type->desc);
 		}
-		doexpressions();
+		if (doexpressions(&options, &buffer, path) != 0) {
+			status = 1;
+		}
 	}
+	free(buffer.data);
+	return status;
 }
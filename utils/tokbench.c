@@ -0,0 +1,182 @@
+/* tokbench -- a benchmark for loading token files
+ * Copyright (C) 2024 Dani Rodríguez <dani@danirod.es>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "parser.h"
+#include "scanner.h"
+#include "tokfile.h"
+
+#define DEFAULT_ROUNDS 20
+
+static double
+now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int
+same_tokens(tokstream_t *a, tokstream_t *b)
+{
+	return a->len == b->len && !memcmp(a->types, b->types, a->len)
+	       && !memcmp(a->offsets, b->offsets, a->len * sizeof(uint32_t))
+	       && !memcmp(a->lengths, b->lengths, a->len * sizeof(uint32_t))
+	       && !memcmp(a->values, b->values, a->len * sizeof(uint32_t));
+}
+
+/* Reads every token once, as parsing would, so that the pages of a
+ * mapped token file are actually loaded and not just mapped. */
+static unsigned long
+walk_tokens(parser_t *parser)
+{
+	tokstream_t *tokens = &parser->tokens;
+	unsigned long sum = 0, i;
+
+	for (i = 0; i < tokens->len; i++) {
+		sum += tokens->types[i] + tokens->offsets[i] + tokens->lengths[i]
+		       + tokens->values[i];
+	}
+	return sum;
+}
+
+/* Maps and scans the source file, like repl and tokens do. */
+static parser_t *
+load_source(int fd)
+{
+	scanner_t *scanner;
+	parser_t *parser;
+
+	if ((scanner = scanner_init_mapped(fd)) == NULL) {
+		return NULL;
+	}
+	parser = parser_new();
+	if (!parser_load_tokens(parser, scanner)) {
+		parser_free(parser);
+		scanner_free(scanner);
+		return NULL;
+	}
+	return parser;
+}
+
+static void
+free_source(parser_t *parser)
+{
+	scanner_t *scanner = parser->scanner;
+
+	parser_free(parser);
+	scanner_free(scanner);
+}
+
+static parser_t *
+load_tokfile(int fd)
+{
+	parser_t *parser = parser_new();
+
+	if (!parser_load_tokfile(parser, fd)) {
+		parser_free(parser);
+		return NULL;
+	}
+	return parser;
+}
+
+int
+main(int argc, char **argv)
+{
+	char path[] = "/tmp/tokbenchXXXXXX";
+	unsigned long rounds = DEFAULT_ROUNDS, r, tokens;
+	unsigned long source_sum = 0, tokfile_sum = 0;
+	double source_time, tokfile_time, start, bytes;
+	parser_t *source, *tokfile;
+	FILE *fp;
+	int fd, tfd, ok;
+
+	if (argc < 2) {
+		fprintf(stderr, "Usage: tokbench file [rounds]\n");
+		return 1;
+	}
+	if (argc > 2) {
+		rounds = strtoul(argv[2], NULL, 10);
+	}
+	if ((fd = open(argv[1], O_RDONLY)) == -1) {
+		perror(argv[1]);
+		return 1;
+	}
+	if ((source = load_source(fd)) == NULL) {
+		fprintf(stderr, "cannot scan %s\n", argv[1]);
+		return 1;
+	}
+	bytes = scanner_length(source->scanner);
+	tokens = source->tokens.len;
+
+	/* write the token file once, and check it loads the same tokens */
+	if ((tfd = mkstemp(path)) == -1 || (fp = fdopen(tfd, "wb")) == NULL) {
+		perror("cannot create token file");
+		return 1;
+	}
+	ok = tokfile_write(fp, source->scanner, &source->tokens);
+	if (fclose(fp) == EOF || !ok || (tfd = open(path, O_RDONLY)) == -1) {
+		perror("cannot write token file");
+		unlink(path);
+		return 1;
+	}
+	unlink(path);
+	if ((tokfile = load_tokfile(tfd)) == NULL
+	    || !same_tokens(&source->tokens, &tokfile->tokens)) {
+		fprintf(stderr, "token file does not match the source\n");
+		return 1;
+	}
+	parser_free(tokfile);
+	free_source(source);
+
+	start = now();
+	for (r = 0; r < rounds; r++) {
+		if ((source = load_source(fd)) == NULL) {
+			return 1;
+		}
+		source_sum += walk_tokens(source);
+		free_source(source);
+	}
+	source_time = now() - start;
+
+	start = now();
+	for (r = 0; r < rounds; r++) {
+		if ((tokfile = load_tokfile(tfd)) == NULL) {
+			return 1;
+		}
+		tokfile_sum += walk_tokens(tokfile);
+		parser_free(tokfile);
+	}
+	tokfile_time = now() - start;
+
+	printf("bytes: %.0f, tokens: %lu, rounds: %lu\n", bytes, tokens, rounds);
+	printf("source:  %10.2f MB/s %10.2f Mtok/s\n",
+	       bytes * rounds / source_time / 1e6,
+	       (double) tokens * rounds / source_time / 1e6);
+	printf("tokfile: %10.2f MB/s %10.2f Mtok/s\n",
+	       bytes * rounds / tokfile_time / 1e6,
+	       (double) tokens * rounds / tokfile_time / 1e6);
+	printf("speedup: %.2fx\n", source_time / tokfile_time);
+	close(tfd);
+	close(fd);
+	return source_sum != tokfile_sum;
+}
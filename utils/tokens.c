@@ -14,17 +14,30 @@
  * You should have received a copy of the GNU General Public License
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 #include "scanner.h"
+#include "tokfile.h"
 #include "token.h"
 
 static void
-print_token(token_t *tok)
+print_token(scanner_t *scanner, token_t *tok)
 {
-	if (tok->meta != 0) {
-		printf("%s(%s)\n", tokentype_string(tok->type), tok->meta);
+	if ((tok->type == TOK_IDENTIFIER || tok->type == TOK_STRING)
+	    && tok->value != 0) {
+		printf("%s(%.*s) #%u\n",
+		       tokentype_string(tok->type),
+		       (int) tok->length,
+		       scanner_lexeme(scanner, tok),
+		       tok->value);
+	} else if (tok->length != 0) {
+		printf("%s(%.*s)\n",
+		       tokentype_string(tok->type),
+		       (int) tok->length,
+		       scanner_lexeme(scanner, tok));
 	} else {
 		puts(tokentype_string(tok->type));
 	}
@@ -37,57 +50,115 @@ openerror()
 	exit(1);
 }
 
+static void
+usage()
+{
+	fprintf(stderr, "Usage: tokens [-i] [-j threads] [-o tokfile] file\n");
+	exit(1);
+}
+
 int
 main(int argc, char **argv)
 {
 	scanner_t *scanner;
-	token_t *tok;
-	int eof = 0;
+	symtab_t *symtab = NULL;
+	strarena_t *strings = NULL;
+	tokstream_t stream;
+	token_t tok;
+	const char *output = NULL;
 	FILE *fp;
-	char *buffer;
-	size_t len;
+	unsigned int threads = 0, i;
+	int eof = 0;
+	int fd, c;
 
-	if (argc == 1) {
+	while ((c = getopt(argc, argv, "ij:o:")) != -1) {
+		switch (c) {
+		case 'i':
+			/* print the ID of every identifier and string. */
+			if ((symtab == NULL && (symtab = symtab_new()) == NULL)
+			    || (strings == NULL
+			        && (strings = strarena_new()) == NULL)) {
+				puts("error: out of memory");
+				return 1;
+			}
+			break;
+		case 'j':
+			threads = strtoul(optarg, NULL, 10);
+			break;
+		case 'o':
+			/* write a token file instead of printing the tokens. */
+			output = optarg;
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind >= argc) {
 		fprintf(stderr, "Please provide the file name\n");
 		exit(1);
 	}
 
-	if ((fp = fopen(argv[1], "r")) == NULL) {
-		openerror();
-	}
-	if (fseek(fp, 0, SEEK_END) == -1) {
-		openerror();
-	}
-	if ((len = ftell(fp)) == -1) {
+	/* map the file if possible, or else read it in chunks, such as when
+	 * it is a pipe, so that it can be of any size. */
+	if ((fd = open(argv[optind], O_RDONLY)) == -1) {
 		openerror();
 	}
-	if (fseek(fp, 0, SEEK_SET) == -1) {
-		openerror();
-	}
-	if ((buffer = malloc(sizeof(char) * len)) == NULL) {
-		openerror();
-	}
-	if (fread(buffer, len, sizeof(char), fp) == 0) {
-		openerror();
-	}
-
-	if ((scanner = scanner_init(buffer, len)) == 0) {
+	if ((scanner = scanner_init_mapped(fd)) == 0
+	    && (scanner = scanner_init_fd(fd, 0)) == 0) {
 		puts("error: scanner_init");
 		return 1;
 	}
+	scanner_set_symtab(scanner, symtab);
+	scanner_set_strarena(scanner, strings);
 
-	do {
-		tok = scanner_next(scanner);
-		if (tok && tok->type != TOK_EOF) {
-			print_token(tok);
+	if (threads > 0 || output) {
+		/* scan everything upfront, splitting the file among threads. */
+		tokstream_init(&stream);
+		if (!scanner_tokenize(scanner, &stream, threads ? threads : 1)) {
+			puts("error: scanner_tokenize");
+			return 1;
+		}
+		if (output) {
+			if (scanner_source(scanner) == NULL) {
+				fprintf(stderr, "token files need a regular file\n");
+				return 1;
+			}
+			if ((fp = fopen(output, "wb")) == NULL
+			    || !tokfile_write(fp, scanner, &stream)
+			    || fclose(fp) == EOF) {
+				perror("cannot write token file");
+				return 1;
+			}
+		} else {
+			for (i = 0; i + 1 < stream.len; i++) {
+				tok = tokstream_get(&stream, i);
+				print_token(scanner, &tok);
+			}
 		}
-		if (tok->type == TOK_EOF) {
-			eof = 1;
+		tokstream_free(&stream);
+	} else {
+		do {
+			tok = scanner_next(scanner);
+			if (tok.type != TOK_EOF) {
+				print_token(scanner, &tok);
+			}
+			if (tok.type == TOK_EOF) {
+				eof = 1;
+			}
+		} while (!eof);
+		if (scanner_failed(scanner)) {
+			puts("error: out of memory");
+			return 1;
 		}
-		token_free(tok);
-		free(tok);
-	} while (!eof);
+	}
 
 	scanner_free(scanner);
+	if (symtab) {
+		symtab_free(symtab);
+	}
+	if (strings) {
+		strarena_free(strings);
+	}
+	close(fd);
 	return 0;
 }